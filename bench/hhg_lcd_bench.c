@@ -0,0 +1,614 @@
+/***************************************************************************
+ *
+ * Hi Happy Garden LCD HITACHI HD44780U
+ * Copyright (C) 2023  Antonio Salsi <passy.linux@zresa.it>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***************************************************************************/
+
+// Drives the same workloads through the kernel module, the libgpiod backend and wiringPi
+// and prints one JSON object per path and workload.
+//
+// Every path returns from the call showing a frame only after its last EN edge, so the
+// latency of the call is the syscall-to-last-edge latency.
+
+#include "hhg_lcd_gpiod.h"
+
+#ifdef HHG_BENCH_WIRINGPI
+#include <wiringPi.h>
+#include <lcd.h>
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HHG_BENCH_FRAMES_DEFAULT (200)
+// workloads are laid out on a 16x2 glass, bigger panels show them in their top left corner
+#define HHG_BENCH_REGIONS_MAX (HHG_ROWS_DEFAULT)
+#define HHG_BENCH_WRITE_MAX (HHG_BENCH_REGIONS_MAX * (HHG_COLS_DEFAULT + 16))
+#define HHG_BENCH_DEV "/dev/hhg_lcd"
+#define HHG_BENCH_SYSFS_TRANSFERS "/sys/class/hhg_lcd/hhg_lcd/bus_transfers"
+#define HHG_BENCH_THREAD_COMM "hhg_lcd"
+
+enum hhg_bench_workload
+{
+    HHG_BENCH_FULL,  ///< Every cell changes at every frame.
+    HHG_BENCH_COUNTER,  ///< A 4 digits counter in a field.
+    HHG_BENCH_SCROLL,  ///< A marquee on the first row.
+    HHG_BENCH_WORKLOADS
+};
+
+static const char* const workload_names[HHG_BENCH_WORKLOADS] = { "full", "counter", "scroll" };
+
+// Cells of the glass updated by a frame
+struct hhg_bench_region
+{
+    u8 row;  ///< Row, 0-based.
+    u8 col;  ///< First column, 0-based.
+    char text[HHG_COLS_DEFAULT + 1];  ///< The cells, NUL terminated.
+};
+
+// One step of a workload
+struct hhg_bench_frame
+{
+    u8 count;  ///< Number of regions.
+    struct hhg_bench_region regions[HHG_BENCH_REGIONS_MAX];  ///< Regions to update.
+};
+
+// Command line
+struct hhg_bench_options
+{
+    const char* path;  ///< Path under test.
+    const char* chip;  ///< GPIO chip of the gpiod path.
+    int lines[6];  ///< RS, EN, DB4-DB7: line offsets for gpiod, wiringPi pins for wiringpi.
+    bool lines_set;  ///< Lines given on the command line.
+    int workload;  ///< Workload to run, HHG_BENCH_WORKLOADS for all.
+    unsigned int frames;  ///< Frames per workload.
+};
+
+// Path under test
+struct hhg_bench_path
+{
+    const char* name;  ///< Name in the output.
+    const char* edges_source;  ///< "counter" when edges are counted on the bus, "model" when computed.
+    int (*open)(const struct hhg_bench_options* options);  ///< Takes the bus, 0 on success.
+    int (*show)(const struct hhg_bench_frame* frame);  ///< Shows a frame, returns after the last edge.
+    unsigned long (*transfers)(const struct hhg_bench_frame* frame);  ///< EN pulses so far, frame is the last shown.
+    unsigned long long (*helper_cpu_ns)(void);  ///< CPU time of the threads working for the path, 0 if none.
+    void (*close)(void);  ///< Releases the bus.
+};
+
+// static decl
+
+/**
+ * @brief Fills the frame of a workload step.
+ *
+ * @param workload The workload.
+ * @param step The step.
+ * @param frame The frame to fill.
+ */
+static void hhg_bench_make_frame(enum hhg_bench_workload workload, unsigned int step, struct hhg_bench_frame* frame);
+
+/**
+ * @brief Encodes a frame as cursor positions and text for the escape sequence parser.
+ *
+ * @param frame The frame.
+ * @param buff Filled with the text.
+ * @return The length of the text.
+ */
+static size_t hhg_bench_encode(const struct hhg_bench_frame* frame, char buff[HHG_BENCH_WRITE_MAX]);
+
+/**
+ * @brief Runs a workload on a path and prints its results.
+ *
+ * @param path The path.
+ * @param workload The workload.
+ * @param frames The number of frames.
+ * @return 0 on success, -1 on failure.
+ */
+static int hhg_bench_run(const struct hhg_bench_path* path, enum hhg_bench_workload workload, unsigned int frames);
+
+/**
+ * @brief Reads a clock in nanoseconds.
+ *
+ * @param clock The clock.
+ * @return The time in nanoseconds.
+ */
+static unsigned long long hhg_bench_now_ns(clockid_t clock);
+
+/**
+ * @brief qsort() comparator of latencies.
+ */
+static int hhg_bench_cmp(const void* a, const void* b);
+
+//KERNEL PATH
+
+static int kernel_fd = -1;  ///< Device opened by the kernel path.
+static pid_t kernel_thread = -1;  ///< Bus thread of the module.
+
+static int hhg_bench_kernel_open(const struct hhg_bench_options* options);
+static int hhg_bench_kernel_show(const struct hhg_bench_frame* frame);
+static unsigned long hhg_bench_kernel_transfers(const struct hhg_bench_frame* frame);
+static unsigned long long hhg_bench_kernel_cpu_ns(void);
+static void hhg_bench_kernel_close(void);
+
+//GPIOD PATH
+
+static struct hhg_lcd_gpiod* gpiod_lcd = NULL;  ///< Handle of the gpiod path.
+
+static int hhg_bench_gpiod_open(const struct hhg_bench_options* options);
+static int hhg_bench_gpiod_show(const struct hhg_bench_frame* frame);
+static unsigned long hhg_bench_gpiod_transfers(const struct hhg_bench_frame* frame);
+static void hhg_bench_gpiod_close(void);
+
+#ifdef HHG_BENCH_WIRINGPI
+//WIRINGPI PATH
+
+static int wiringpi_lcd = -1;  ///< Handle of the wiringPi path.
+static unsigned long wiringpi_transfers = 0;  ///< EN pulses computed from the bytes sent.
+
+static int hhg_bench_wiringpi_open(const struct hhg_bench_options* options);
+static int hhg_bench_wiringpi_show(const struct hhg_bench_frame* frame);
+static unsigned long hhg_bench_wiringpi_transfers(const struct hhg_bench_frame* frame);
+static void hhg_bench_wiringpi_close(void);
+#endif
+
+static const struct hhg_bench_path paths[] = {
+    {
+        .name = "kernel",
+        .edges_source = "counter",
+        .open = hhg_bench_kernel_open,
+        .show = hhg_bench_kernel_show,
+        .transfers = hhg_bench_kernel_transfers,
+        .helper_cpu_ns = hhg_bench_kernel_cpu_ns,
+        .close = hhg_bench_kernel_close,
+    },
+    {
+        .name = "gpiod",
+        .edges_source = "counter",
+        .open = hhg_bench_gpiod_open,
+        .show = hhg_bench_gpiod_show,
+        .transfers = hhg_bench_gpiod_transfers,
+        .helper_cpu_ns = NULL,
+        .close = hhg_bench_gpiod_close,
+    },
+#ifdef HHG_BENCH_WIRINGPI
+    {
+        .name = "wiringpi",
+        .edges_source = "model",
+        .open = hhg_bench_wiringpi_open,
+        .show = hhg_bench_wiringpi_show,
+        .transfers = hhg_bench_wiringpi_transfers,
+        .helper_cpu_ns = NULL,
+        .close = hhg_bench_wiringpi_close,
+    },
+#endif
+};
+
+int main(int argc, char* argv[])
+{
+    static const struct option long_options[] = {
+        { "path", required_argument, NULL, 'p' },
+        { "chip", required_argument, NULL, 'c' },
+        { "lines", required_argument, NULL, 'l' },
+        { "workload", required_argument, NULL, 'w' },
+        { "frames", required_argument, NULL, 'n' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct hhg_bench_options options = {
+        .path = NULL,
+        .chip = "/dev/gpiochip0",
+        .lines = { 0, 1, 2, 3, 4, 5 },
+        .lines_set = false,
+        .workload = HHG_BENCH_WORKLOADS,
+        .frames = HHG_BENCH_FRAMES_DEFAULT,
+    };
+    int opt;
+
+    while((opt = getopt_long(argc, argv, "p:c:l:w:n:", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            options.path = optarg;
+            break;
+        case 'c':
+            options.chip = optarg;
+            break;
+        case 'l':
+            if(sscanf(optarg, "%d,%d,%d,%d,%d,%d", &options.lines[0], &options.lines[1], &options.lines[2],
+                &options.lines[3], &options.lines[4], &options.lines[5]) != 6)
+            {
+                fprintf(stderr, "--lines wants rs,en,db4,db5,db6,db7\n");
+                return 1;
+            }
+            options.lines_set = true;
+            break;
+        case 'w':
+            for(options.workload = 0; options.workload < HHG_BENCH_WORKLOADS; options.workload++)
+            {
+                if(strcmp(optarg, workload_names[options.workload]) == 0)
+                {
+                    break;
+                }
+            }
+            if(options.workload == HHG_BENCH_WORKLOADS)
+            {
+                fprintf(stderr, "unknown workload %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            options.frames = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s --path kernel|gpiod|wiringpi [--chip /dev/gpiochipN] [--lines rs,en,db4,db5,db6,db7]"
+                " [--workload full|counter|scroll] [--frames n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const struct hhg_bench_path* path = NULL;
+    for(size_t i = 0; options.path && i < sizeof(paths) / sizeof(paths[0]); i++)
+    {
+        if(strcmp(options.path, paths[i].name) == 0)
+        {
+            path = &paths[i];
+        }
+    }
+    if(!path || options.frames == 0)
+    {
+        fprintf(stderr, "unknown or not built path, or no frames\n");
+        return 1;
+    }
+
+    if(path->open(&options) != 0)
+    {
+        perror(path->name);
+        return 1;
+    }
+
+    int ret = 0;
+    for(int workload = 0; workload < HHG_BENCH_WORKLOADS && ret == 0; workload++)
+    {
+        if(options.workload == HHG_BENCH_WORKLOADS || options.workload == workload)
+        {
+            ret = hhg_bench_run(path, workload, options.frames);
+        }
+    }
+
+    path->close();
+
+    return ret == 0 ? 0 : 1;
+}
+
+void hhg_bench_make_frame(enum hhg_bench_workload workload, unsigned int step, struct hhg_bench_frame* frame)
+{
+    static const char marquee[] = "Hi Happy Garden - HD44780U benchmark - ";
+    const size_t marquee_len = sizeof(marquee) - 1;
+
+    switch (workload)
+    {
+    case HHG_BENCH_FULL:
+        frame->count = HHG_ROWS_DEFAULT;
+        for(u8 row = 0; row < HHG_ROWS_DEFAULT; row++)
+        {
+            frame->regions[row].row = row;
+            frame->regions[row].col = 0;
+            for(u8 col = 0; col < HHG_COLS_DEFAULT; col++)
+            {
+                frame->regions[row].text[col] = (row ? 'a' : 'A') + (step + col + row) % 26;
+            }
+            frame->regions[row].text[HHG_COLS_DEFAULT] = '\0';
+        }
+        break;
+    case HHG_BENCH_COUNTER:
+        frame->count = 1;
+        frame->regions[0].row = 1;
+        frame->regions[0].col = 12;
+        snprintf(frame->regions[0].text, sizeof(frame->regions[0].text), "%4u", step % 10000);
+        break;
+    case HHG_BENCH_SCROLL:
+        frame->count = 1;
+        frame->regions[0].row = 0;
+        frame->regions[0].col = 0;
+        for(u8 col = 0; col < HHG_COLS_DEFAULT; col++)
+        {
+            frame->regions[0].text[col] = marquee[(step + col) % marquee_len];
+        }
+        frame->regions[0].text[HHG_COLS_DEFAULT] = '\0';
+        break;
+    default:
+        frame->count = 0;
+        break;
+    }
+}
+
+size_t hhg_bench_encode(const struct hhg_bench_frame* frame, char buff[HHG_BENCH_WRITE_MAX])
+{
+    size_t len = 0;
+
+    for(u8 i = 0; i < frame->count; i++)
+    {
+        const struct hhg_bench_region* region = &frame->regions[i];
+        len += snprintf(&buff[len], HHG_BENCH_WRITE_MAX - len, "\033[%u;%uH%s", region->row + 1, region->col + 1, region->text);
+    }
+
+    return len;
+}
+
+int hhg_bench_run(const struct hhg_bench_path* path, enum hhg_bench_workload workload, unsigned int frames)
+{
+    struct hhg_bench_frame frame;
+    unsigned long long* latencies = calloc(frames, sizeof(*latencies));
+    if(!latencies)
+    {
+        return -1;
+    }
+
+    //step 0 puts the workload on the glass, not measured
+    hhg_bench_make_frame(workload, 0, &frame);
+    if(path->show(&frame) != 0)
+    {
+        perror(path->name);
+        free(latencies);
+        return -1;
+    }
+
+    unsigned long transfers_before = path->transfers(&frame);
+    unsigned long long cpu_before = hhg_bench_now_ns(CLOCK_PROCESS_CPUTIME_ID) + (path->helper_cpu_ns ? path->helper_cpu_ns() : 0);
+
+    for(unsigned int i = 0; i < frames; i++)
+    {
+        hhg_bench_make_frame(workload, i + 1, &frame);
+
+        unsigned long long start = hhg_bench_now_ns(CLOCK_MONOTONIC);
+        if(path->show(&frame) != 0)
+        {
+            perror(path->name);
+            free(latencies);
+            return -1;
+        }
+        latencies[i] = hhg_bench_now_ns(CLOCK_MONOTONIC) - start;
+    }
+
+    unsigned long long cpu = hhg_bench_now_ns(CLOCK_PROCESS_CPUTIME_ID) + (path->helper_cpu_ns ? path->helper_cpu_ns() : 0) - cpu_before;
+    unsigned long transfers = path->transfers(&frame) - transfers_before;
+
+    qsort(latencies, frames, sizeof(*latencies), hhg_bench_cmp);
+
+    //each EN pulse is a rising and a falling edge
+    printf("{\"path\":\"%s\",\"workload\":\"%s\",\"frames\":%u,"
+        "\"latency_us\":{\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f},"
+        "\"edges_per_frame\":%.1f,\"edges_source\":\"%s\",\"cpu_us_per_frame\":%.1f}\n",
+        path->name, workload_names[workload], frames,
+        latencies[(frames - 1) * 50 / 100] / 1000.0,
+        latencies[(frames - 1) * 99 / 100] / 1000.0,
+        latencies[frames - 1] / 1000.0,
+        2.0 * transfers / frames, path->edges_source,
+        cpu / 1000.0 / frames);
+    fflush(stdout);
+
+    free(latencies);
+
+    return 0;
+}
+
+unsigned long long hhg_bench_now_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int hhg_bench_cmp(const void* a, const void* b)
+{
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+
+    return (x > y) - (x < y);
+}
+
+//KERNEL PATH
+
+int hhg_bench_kernel_open(const struct hhg_bench_options* options)
+{
+    kernel_fd = open(HHG_BENCH_DEV, O_WRONLY);
+    if(kernel_fd < 0)
+    {
+        return -1;
+    }
+
+    //the bus owner does the work, its CPU time is part of the cost
+    DIR* proc = opendir("/proc");
+    struct dirent* entry;
+    while(proc && (entry = readdir(proc)) != NULL)
+    {
+        char file[288];
+        char comm[32] = { 0 };
+
+        snprintf(file, sizeof(file), "/proc/%s/comm", entry->d_name);
+        FILE* f = fopen(file, "r");
+        if(!f)
+        {
+            continue;
+        }
+        if(fgets(comm, sizeof(comm), f) && strcmp(comm, HHG_BENCH_THREAD_COMM "\n") == 0)
+        {
+            kernel_thread = atoi(entry->d_name);
+        }
+        fclose(f);
+    }
+    if(proc)
+    {
+        closedir(proc);
+    }
+
+    return 0;
+}
+
+int hhg_bench_kernel_show(const struct hhg_bench_frame* frame)
+{
+    char buff[HHG_BENCH_WRITE_MAX];
+    size_t len = hhg_bench_encode(frame, buff);
+
+    //the write returns once the bus owner has executed it
+    return write(kernel_fd, buff, len) == (ssize_t)len ? 0 : -1;
+}
+
+unsigned long hhg_bench_kernel_transfers(const struct hhg_bench_frame* frame)
+{
+    unsigned long transfers = 0;
+
+    FILE* f = fopen(HHG_BENCH_SYSFS_TRANSFERS, "r");
+    if(f)
+    {
+        if(fscanf(f, "%lu", &transfers) != 1)
+        {
+            transfers = 0;
+        }
+        fclose(f);
+    }
+
+    return transfers;
+}
+
+unsigned long long hhg_bench_kernel_cpu_ns(void)
+{
+    unsigned long long ns = 0;
+    char file[64];
+
+    if(kernel_thread < 0)
+    {
+        return 0;
+    }
+
+    //first field: time spent on the CPU in ns
+    snprintf(file, sizeof(file), "/proc/%d/schedstat", kernel_thread);
+    FILE* f = fopen(file, "r");
+    if(f)
+    {
+        if(fscanf(f, "%llu", &ns) != 1)
+        {
+            ns = 0;
+        }
+        fclose(f);
+    }
+
+    return ns;
+}
+
+void hhg_bench_kernel_close(void)
+{
+    close(kernel_fd);
+    kernel_fd = -1;
+}
+
+//GPIOD PATH
+
+int hhg_bench_gpiod_open(const struct hhg_bench_options* options)
+{
+    struct hhg_lcd_gpiod_pins pins = {
+        .chip = options->chip,
+        .rs = options->lines[0],
+        .en = options->lines[1],
+        .db = { HHG_GPIOD_LINE_NONE, HHG_GPIOD_LINE_NONE, HHG_GPIOD_LINE_NONE, HHG_GPIOD_LINE_NONE,
+            options->lines[2], options->lines[3], options->lines[4], options->lines[5] },
+    };
+
+    gpiod_lcd = hhg_lcd_gpiod_open(&pins, NULL, false);
+
+    return gpiod_lcd ? 0 : -1;
+}
+
+int hhg_bench_gpiod_show(const struct hhg_bench_frame* frame)
+{
+    char buff[HHG_BENCH_WRITE_MAX];
+    size_t len = hhg_bench_encode(frame, buff);
+
+    int ret = hhg_lcd_gpiod_write(gpiod_lcd, buff, len);
+    if(ret != 0)
+    {
+        errno = -ret;
+        return -1;
+    }
+
+    return 0;
+}
+
+unsigned long hhg_bench_gpiod_transfers(const struct hhg_bench_frame* frame)
+{
+    return hhg_lcd_gpiod_transfers(gpiod_lcd);
+}
+
+void hhg_bench_gpiod_close(void)
+{
+    hhg_lcd_gpiod_close(gpiod_lcd);
+    gpiod_lcd = NULL;
+}
+
+#ifdef HHG_BENCH_WIRINGPI
+//WIRINGPI PATH
+
+int hhg_bench_wiringpi_open(const struct hhg_bench_options* options)
+{
+    //pins of test/test_wiringpi.c unless given
+    static const int defaults[6] = { 25, 24, 23, 22, 21, 14 };
+    const int* lines = options->lines_set ? options->lines : defaults;
+
+    if(wiringPiSetup() != 0)
+    {
+        return -1;
+    }
+
+    wiringpi_lcd = lcdInit(HHG_ROWS_DEFAULT, HHG_COLS_DEFAULT, 4, lines[0], lines[1], lines[2], lines[3], lines[4], lines[5], 0, 0, 0, 0);
+
+    return wiringpi_lcd < 0 ? -1 : 0;
+}
+
+int hhg_bench_wiringpi_show(const struct hhg_bench_frame* frame)
+{
+    for(u8 i = 0; i < frame->count; i++)
+    {
+        const struct hhg_bench_region* region = &frame->regions[i];
+
+        lcdPosition(wiringpi_lcd, region->col, region->row);
+        lcdPuts(wiringpi_lcd, region->text);
+
+        //no diff: a set address and every byte of the region, two nibbles each
+        wiringpi_transfers += 2 * (1 + strlen(region->text));
+    }
+
+    return 0;
+}
+
+unsigned long hhg_bench_wiringpi_transfers(const struct hhg_bench_frame* frame)
+{
+    return wiringpi_transfers;
+}
+
+void hhg_bench_wiringpi_close(void)
+{
+    wiringpi_lcd = -1;
+}
+#endif
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Runs the benchmark on a simulated GPIO chip, the kernel module first and then the libgpiod backend.
+# One JSON object per path and workload on stdout.
+# Wiring on the chip: RS 0, E 1, D4-D7 2..5. GPIO_BASE overrides the legacy number of line 0.
+# usage: run.sh [frames]   as root, from a tree where hhg_lcd.ko and bench/hhg_lcd_bench are built
+
+DIR=$(dirname "$0")
+FRAMES=${1:-200}
+
+CHIP=$("$DIR/../test/gpio-sim.sh" up) || exit 1
+trap '"$DIR/../test/gpio-sim.sh" down' EXIT
+
+# the module takes legacy GPIO numbers, find the base of the simulated chip
+if [ -z "$GPIO_BASE" ]; then
+    for entry in /sys/class/gpio/gpiochip*; do
+        if [ "$(basename "$(readlink -f "$entry/device")")" = "$(basename "$CHIP")" ]; then
+            GPIO_BASE=$(cat "$entry/base")
+        fi
+    done
+fi
+if [ -z "$GPIO_BASE" ]; then
+    echo "base of $CHIP not found, set GPIO_BASE" >&2
+    exit 1
+fi
+
+insmod "$DIR/../hhg_lcd.ko" gpio_rs=$GPIO_BASE gpio_en=$((GPIO_BASE + 1)) \
+    gpio_db4=$((GPIO_BASE + 2)) gpio_db5=$((GPIO_BASE + 3)) gpio_db6=$((GPIO_BASE + 4)) gpio_db7=$((GPIO_BASE + 5)) || exit 1
+"$DIR/hhg_lcd_bench" --path kernel --frames "$FRAMES"
+rmmod hhg_lcd
+
+"$DIR/hhg_lcd_bench" --path gpiod --chip "$CHIP" --lines 0,1,2,3,4,5 --frames "$FRAMES"
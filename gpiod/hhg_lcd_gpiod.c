@@ -0,0 +1,352 @@
+/***************************************************************************
+ *
+ * Hi Happy Garden LCD HITACHI HD44780U
+ * Copyright (C) 2023  Antonio Salsi <passy.linux@zresa.it>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***************************************************************************/
+
+#include "hhg_lcd_gpiod.h"
+
+#include <gpiod.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define HHG_GPIOD_CONSUMER "hhg_lcd"
+#define HHG_GPIOD_LINES_MAX (10)  ///< RS, 8 data lines and EN.
+
+struct hhg_lcd_gpiod
+{
+    struct hhg_lcd_core core;  ///< Protocol, shadow framebuffer and refresh, shared with the module.
+    struct hhg_lcd_esc esc;  ///< Parser state, kept across writes.
+    struct gpiod_chip* chip;  ///< The GPIO chip.
+    struct gpiod_line_request* request;  ///< All the lines: RS, the wired data lines from the lowest, EN.
+    unsigned int lines_count;  ///< Number of requested lines.
+    u8 first_db;  ///< First wired data pin, 0 in 8-bit mode, 4 in 4-bit mode.
+    enum gpiod_line_value values[HHG_GPIOD_LINES_MAX];  ///< Values of the requested lines, in request order.
+    int error;  ///< First line error of the current call, as -errno.
+    unsigned long transfers;  ///< EN pulses since open.
+};
+
+// static decl
+
+/**
+ * @brief Sleeps for the given time.
+ *
+ * @param us Time in microseconds.
+ */
+static void hhg_lcd_gpiod_sleep_us(unsigned int us);
+
+/**
+ * @brief Puts bits on a run of data lines and pulses EN.
+ *
+ * RS and the data lines are set in one multi-line set before EN rises, the round trip
+ * of each set is longer than the 450 ns EN pulse width.
+ *
+ * @param lcd The handle.
+ * @param value The bits, the first one goes on first_db.
+ * @param first_db First data pin.
+ * @param count Number of data pins.
+ * @param rs_value HHG_COMMAND_MODE or HHG_DATA_MODE.
+ */
+static void hhg_lcd_gpiod_xfer_bits(struct hhg_lcd_gpiod* lcd, u8 value, u8 first_db, u8 count, bool rs_value);
+
+/**
+ * @brief Sets all the requested lines to lcd->values, the first error is kept in lcd->error.
+ *
+ * @param lcd The handle.
+ */
+static void hhg_lcd_gpiod_set_values(struct hhg_lcd_gpiod* lcd);
+
+/**
+ * @brief Core op, sends bus words in order.
+ */
+static void hhg_lcd_gpiod_replay(void* ctx, const u16 words[], u16 count);
+
+/**
+ * @brief Core op, sleeps for the given range of microseconds.
+ */
+static void hhg_lcd_gpiod_delay(void* ctx, unsigned int min_us, unsigned int max_us);
+
+/**
+ * @brief Takes the first line error of the call and clears it.
+ *
+ * @param lcd The handle.
+ * @return 0 on success, -errno on a line error.
+ */
+static int hhg_lcd_gpiod_status(struct hhg_lcd_gpiod* lcd);
+
+static const struct hhg_lcd_core_ops gpiod_ops = {
+    .replay = hhg_lcd_gpiod_replay,
+    .delay = hhg_lcd_gpiod_delay,
+};
+
+struct hhg_lcd_gpiod* hhg_lcd_gpiod_open(const struct hhg_lcd_gpiod_pins* pins, const struct hhg_lcd_geometry* geometry, bool warm_start)
+{
+    struct hhg_lcd_geometry geometry_default;
+    bool bus_8_bit;
+
+    if(!pins || !pins->chip || pins->rs == HHG_GPIOD_LINE_NONE || pins->en == HHG_GPIOD_LINE_NONE)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if(!geometry)
+    {
+        hhg_lcd_geometry_init(&geometry_default, HHG_ROWS_DEFAULT, HHG_COLS_DEFAULT, NULL);
+        geometry = &geometry_default;
+    }
+
+    //all the data pins, or only DB4-DB7
+    bus_8_bit = pins->db[0] != HHG_GPIOD_LINE_NONE;
+    for(u8 i = 0; i < 8; i++)
+    {
+        bool wired = pins->db[i] != HHG_GPIOD_LINE_NONE;
+        if(wired != (bus_8_bit || i >= 4))
+        {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+
+    struct hhg_lcd_gpiod* lcd = calloc(1, sizeof(*lcd));
+    if(!lcd)
+    {
+        return NULL;
+    }
+    lcd->first_db = bus_8_bit ? 0 : 4;
+
+    unsigned int offsets[HHG_GPIOD_LINES_MAX];
+    offsets[lcd->lines_count++] = pins->rs;
+    for(u8 i = lcd->first_db; i < 8; i++)
+    {
+        offsets[lcd->lines_count++] = pins->db[i];
+    }
+    offsets[lcd->lines_count++] = pins->en;
+
+    lcd->chip = gpiod_chip_open(pins->chip);
+    if(!lcd->chip)
+    {
+        goto r_free;
+    }
+
+    struct gpiod_line_settings* settings = gpiod_line_settings_new();
+    struct gpiod_line_config* line_cfg = gpiod_line_config_new();
+    struct gpiod_request_config* req_cfg = gpiod_request_config_new();
+    if(settings && line_cfg && req_cfg
+        && gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT) == 0
+        && gpiod_line_settings_set_output_value(settings, GPIOD_LINE_VALUE_INACTIVE) == 0
+        && gpiod_line_config_add_line_settings(line_cfg, offsets, lcd->lines_count, settings) == 0)
+    {
+        gpiod_request_config_set_consumer(req_cfg, HHG_GPIOD_CONSUMER);
+        lcd->request = gpiod_chip_request_lines(lcd->chip, req_cfg, line_cfg);
+    }
+    gpiod_request_config_free(req_cfg);
+    gpiod_line_config_free(line_cfg);
+    gpiod_line_settings_free(settings);
+
+    if(!lcd->request)
+    {
+        goto r_chip;
+    }
+
+    for(unsigned int i = 0; i < lcd->lines_count; i++)
+    {
+        lcd->values[i] = GPIOD_LINE_VALUE_INACTIVE;
+    }
+
+    hhg_lcd_core_setup(&lcd->core, &gpiod_ops, lcd, bus_8_bit, geometry);
+    hhg_lcd_esc_reset(&lcd->esc);
+
+    if(warm_start)
+    {
+        hhg_lcd_core_warm(&lcd->core, false);
+    }
+    else
+    {
+        hhg_lcd_core_power_on(&lcd->core);
+    }
+
+    int ret = hhg_lcd_gpiod_status(lcd);
+    if(ret != 0)
+    {
+        gpiod_line_request_release(lcd->request);
+        errno = -ret;
+        goto r_chip;
+    }
+
+    return lcd;
+
+r_chip:
+    gpiod_chip_close(lcd->chip);
+r_free:
+    free(lcd);
+    return NULL;
+}
+
+void hhg_lcd_gpiod_close(struct hhg_lcd_gpiod* lcd)
+{
+    if(!lcd)
+    {
+        return;
+    }
+
+    gpiod_line_request_release(lcd->request);
+    gpiod_chip_close(lcd->chip);
+    free(lcd);
+}
+
+int hhg_lcd_gpiod_write(struct hhg_lcd_gpiod* lcd, const char* buff, size_t len)
+{
+    hhg_lcd_core_stream(&lcd->core, &lcd->esc, buff, len, false);
+
+    return hhg_lcd_gpiod_status(lcd);
+}
+
+int hhg_lcd_gpiod_frame(struct hhg_lcd_gpiod* lcd, const char frame[])
+{
+    hhg_lcd_core_flush(&lcd->core, frame);
+    hhg_lcd_core_show_cursor(&lcd->core);
+
+    return hhg_lcd_gpiod_status(lcd);
+}
+
+int hhg_lcd_gpiod_clear(struct hhg_lcd_gpiod* lcd)
+{
+    hhg_lcd_core_clear(&lcd->core);
+
+    return hhg_lcd_gpiod_status(lcd);
+}
+
+int hhg_lcd_gpiod_set_flags(struct hhg_lcd_gpiod* lcd, u8 flags)
+{
+    hhg_lcd_core_set_flags(&lcd->core, flags);
+
+    return hhg_lcd_gpiod_status(lcd);
+}
+
+size_t hhg_lcd_gpiod_read(const struct hhg_lcd_gpiod* lcd, char buff[HHG_FRAME_MAX_LEN])
+{
+    const u8 cols = lcd->core.geometry.cols;
+    char frame[HHG_CELLS_MAX];
+    size_t len = 0;
+
+    hhg_lcd_core_frame(&lcd->core, frame);
+    for(u8 row = 0; row < lcd->core.geometry.rows; row++)
+    {
+        memcpy(&buff[len], &frame[row * cols], cols);
+        len += cols;
+        buff[len++] = '\n';
+    }
+
+    return len;
+}
+
+unsigned long hhg_lcd_gpiod_transfers(const struct hhg_lcd_gpiod* lcd)
+{
+    return lcd->transfers;
+}
+
+void hhg_lcd_gpiod_sleep_us(unsigned int us)
+{
+    struct timespec ts = {
+        .tv_sec = us / 1000000,
+        .tv_nsec = (us % 1000000) * 1000L,
+    };
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR)
+    {
+    }
+}
+
+void hhg_lcd_gpiod_xfer_bits(struct hhg_lcd_gpiod* lcd, u8 value, u8 first_db, u8 count, bool rs_value)
+{
+    enum gpiod_line_value* values = lcd->values;
+    const unsigned int en = lcd->lines_count - 1;
+
+    values[0] = rs_value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+    for(u8 i = 0; i < count; i++)
+    {
+        values[1 + first_db - lcd->first_db + i] = (value >> i) & 0x01 ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+    }
+
+    values[en] = GPIOD_LINE_VALUE_INACTIVE;
+    hhg_lcd_gpiod_set_values(lcd);
+
+    values[en] = GPIOD_LINE_VALUE_ACTIVE;
+    hhg_lcd_gpiod_set_values(lcd);
+
+    values[en] = GPIOD_LINE_VALUE_INACTIVE;
+    hhg_lcd_gpiod_set_values(lcd);
+
+    lcd->transfers++;
+}
+
+void hhg_lcd_gpiod_set_values(struct hhg_lcd_gpiod* lcd)
+{
+    if(gpiod_line_request_set_values(lcd->request, lcd->values) < 0 && lcd->error == 0)
+    {
+        lcd->error = -errno;
+    }
+}
+
+void hhg_lcd_gpiod_replay(void* ctx, const u16 words[], u16 count)
+{
+    struct hhg_lcd_gpiod* lcd = ctx;
+
+    for(u16 i = 0; i < count; i++)
+    {
+        const u16 word = words[i];
+        const bool rs_value = word & HHG_WORD_RS;
+
+        // previous instruction done
+        hhg_lcd_gpiod_sleep_us(word & HHG_WORD_DELAY_EXEC ? HHG_EXEC_MIN_US : HHG_DATA_MIN_US);
+
+        if(word & HHG_WORD_NIBBLE)
+        {
+            hhg_lcd_gpiod_xfer_bits(lcd, word >> 4, 4, 4, HHG_COMMAND_MODE);
+        }
+        else if(lcd->core.bus_8_bit)
+        {
+            hhg_lcd_gpiod_xfer_bits(lcd, word, 0, 8, rs_value);
+        }
+        else
+        {
+            hhg_lcd_gpiod_xfer_bits(lcd, word >> 4, 4, 4, rs_value);     // upper
+            hhg_lcd_gpiod_xfer_bits(lcd, word & 0x0F, 4, 4, rs_value);   // lower
+        }
+
+        if(word & HHG_WORD_DELAY_LONG)
+        {
+            hhg_lcd_gpiod_sleep_us(HHG_EXEC_LONG_MIN_US);   // clear or return home done
+        }
+    }
+}
+
+void hhg_lcd_gpiod_delay(void* ctx, unsigned int min_us, unsigned int max_us)
+{
+    hhg_lcd_gpiod_sleep_us(min_us);
+}
+
+int hhg_lcd_gpiod_status(struct hhg_lcd_gpiod* lcd)
+{
+    int ret = lcd->error;
+
+    lcd->error = 0;
+
+    return ret;
+}
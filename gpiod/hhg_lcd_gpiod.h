@@ -0,0 +1,116 @@
+/***************************************************************************
+ *
+ * Hi Happy Garden LCD HITACHI HD44780U
+ * Copyright (C) 2023  Antonio Salsi <passy.linux@zresa.it>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***************************************************************************/
+
+#ifndef _HHG_LCD_GPIOD_H_
+#define _HHG_LCD_GPIOD_H_
+
+// Userspace backend of the driver core on the libgpiod v2 line-request API,
+// for hosts that cannot load the module. Same layout, escape sequences and refresh as /dev/hhg_lcd.
+
+#include "hhg_lcd_core.h"
+
+#define HHG_GPIOD_LINE_NONE (-1)
+
+// Line offsets on the GPIO chip, HHG_GPIOD_LINE_NONE for the pins not wired
+struct hhg_lcd_gpiod_pins
+{
+    const char* chip;  ///< GPIO chip path, for instance "/dev/gpiochip0".
+    int rs;  ///< RS - Select registers.
+    int en;  ///< EN - Start data read/write.
+    int db[8];  ///< DB0 to DB7, DB0-DB3 not wired in 4-bit mode.
+};
+
+struct hhg_lcd_gpiod;
+
+// A handle is not thread safe, the calls on one handle must be serialized by the caller.
+
+/**
+ * @brief Requests the lines and initializes the panel.
+ *
+ * @param pins The wiring.
+ * @param geometry The layout of the glass, see hhg_lcd_geometry_init(), NULL for 16x2.
+ * @param warm_start `true` to skip the power-on reset, the panel is already initialized.
+ * @return The handle, NULL on failure with errno set.
+ */
+struct hhg_lcd_gpiod* hhg_lcd_gpiod_open(const struct hhg_lcd_gpiod_pins* pins, const struct hhg_lcd_geometry* geometry, bool warm_start);
+
+/**
+ * @brief Releases the lines, the panel keeps showing its content.
+ *
+ * @param lcd The handle, can be NULL.
+ */
+void hhg_lcd_gpiod_close(struct hhg_lcd_gpiod* lcd);
+
+/**
+ * @brief Writes a text stream, as a write() on /dev/hhg_lcd.
+ *
+ * The first write on the handle replaces the whole screen when it starts with plain text,
+ * escape sequences update only the cells they touch and later writes continue from the cursor.
+ *
+ * @param lcd The handle.
+ * @param buff The text.
+ * @param len The length of the text.
+ * @return 0 on success, -errno on a line error.
+ */
+int hhg_lcd_gpiod_write(struct hhg_lcd_gpiod* lcd, const char* buff, size_t len);
+
+/**
+ * @brief Shows a frame, only the cells differing from the glass are sent.
+ *
+ * @param lcd The handle.
+ * @param frame The frame, rows * cols cells row after row, HHG_CELL_KEEP cells are left untouched.
+ * @return 0 on success, -errno on a line error.
+ */
+int hhg_lcd_gpiod_frame(struct hhg_lcd_gpiod* lcd, const char frame[]);
+
+/**
+ * @brief Clears the display.
+ *
+ * @param lcd The handle.
+ * @return 0 on success, -errno on a line error.
+ */
+int hhg_lcd_gpiod_clear(struct hhg_lcd_gpiod* lcd);
+
+/**
+ * @brief Sets the display flags, see enum hhg_lcd_flag.
+ *
+ * @param lcd The handle.
+ * @param flags The flags to be set.
+ * @return 0 on success, -errno on a line error.
+ */
+int hhg_lcd_gpiod_set_flags(struct hhg_lcd_gpiod* lcd, u8 flags);
+
+/**
+ * @brief Copies the content of the glass, one row per line, as a read() on /dev/hhg_lcd.
+ *
+ * @param lcd The handle.
+ * @param buff Filled with the rows, at least HHG_FRAME_MAX_LEN bytes.
+ * @return The number of bytes filled.
+ */
+size_t hhg_lcd_gpiod_read(const struct hhg_lcd_gpiod* lcd, char buff[HHG_FRAME_MAX_LEN]);
+
+/**
+ * @brief Returns the number of EN pulses since open, each one is two edges.
+ *
+ * @param lcd The handle.
+ * @return The number of EN pulses.
+ */
+unsigned long hhg_lcd_gpiod_transfers(const struct hhg_lcd_gpiod* lcd);
+
+#endif
@@ -22,44 +22,52 @@
 
 #include <linux/types.h>
 
+#include "hhg_lcd_core.h"
+
 #define HHG_DRIVER_NAME "hhg_lcd"
 #define HHG_CLASS_NAME "hhg_lcd"
 #define HHG_MAJOR_NUM_START (0)
 #define HHG_MINOR_NUM_COUNT (1)
 
-#define HHG_ROWS (2)
-#define HHG_COLS (16)
-
-
-#define HHG_COMMAND_MODE (0)
-#define HHG_DATA_MODE (1)
-
 enum hhg_row
 {
     HHG_FIRST_ROW = 1,
     HHG_SECOND_ROW = 2,
+    HHG_THIRD_ROW = 3,
+    HHG_FOURTH_ROW = 4,
 };
 
-//Sets entire display (D) on/off,
-// cursor on/off (C), and
-// blinking of cursor position
-// character (B).
-enum hhg_lcd_flag
+// All the entry points below are serialized on the bus by a single owner and can be
+// called concurrently. They wait for the bus owner and may sleep, so they need process
+// context, except hhg_lcd_submit() that only queues and is safe from atomic context.
+
+// Flags for hhg_lcd_submit().
+enum hhg_lcd_submit_flag
 {
-    HHG_LCD_DISPLAY_OFF = 0x00,
-    HHG_LCD_BLINK_ON    = 0x01,
-    HHG_LCD_CURSOR_ON   = 0x02,
-    HHG_LCD_DISPLAY_ON  = 0x04
+    HHG_LCD_SUBMIT_DEFAULT = 0x00,
+    HHG_LCD_SUBMIT_REPLACE = 0x01   // superseded by a newer replaceable frame still pending in the queue
 };
 
+/**
+ * @brief Completion callback of hhg_lcd_submit().
+ *
+ * Called by the bus owner in process context. It must not call the entry points that
+ * wait for the bus owner, hhg_lcd_send_str() and the others: they would wait for the
+ * callback itself and are dropped with a warning. hhg_lcd_submit() can be called.
+ *
+ * @param ctx The context passed to hhg_lcd_submit().
+ * @param status 0 when the frame is on the glass, -ECANCELED if it has been superseded.
+ */
+typedef void (*hhg_lcd_callback)(void* ctx, int status);
+
 /**
  * @brief Sends a command to the LCD.
  *
- * This function sends a command to the LCD.
+ * This function sends a command to the LCD, the whole byte in both 4-bit and 8-bit mode.
  *
  * @param command The command to be sent.
  */
- void hhg_lcd_send_command(u8 command);
+void hhg_lcd_send_command(u8 command);
 
 /**
  * @brief Sends char to the LCD.
@@ -92,7 +100,7 @@ void hhg_lcd_clear(void);
  *
  * This function selects the row on the HHG LCD where the subsequent text will be written.
  *
- * @param row The row number to select (0 for the first row, 1 for the second row, etc.).
+ * @param row The row number to select, rows past the last one of the glass are ignored.
  */
 void hhg_lcd_select_row(enum hhg_row row);
 
@@ -105,5 +113,19 @@ void hhg_lcd_select_row(enum hhg_row row);
  */
 void hhg_lcd_set_flags(u8 flags);
 
+/**
+ * @brief Queues a frame for the LCD without waiting.
+ *
+ * The frame is laid out as hhg_lcd_send_str() does and copied, so the caller
+ * can reuse it on return. Safe to call from atomic and IRQ context.
+ *
+ * @param frame The string to be shown, longer strings are truncated at HHG_FRAME_MAX_LEN.
+ * @param flags Submission flags, see enum hhg_lcd_submit_flag.
+ * @param callback Called when the frame is on the glass, can be NULL.
+ * @param ctx Context passed to the callback.
+ * @return 0 on success, -EINVAL or -ENOMEM on failure.
+ */
+int hhg_lcd_submit(const char frame[], u32 flags, hhg_lcd_callback callback, void* ctx);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,800 @@
+/***************************************************************************
+ *
+ * Hi Happy Garden LCD HITACHI HD44780U
+ * Copyright (C) 2023  Antonio Salsi <passy.linux@zresa.it>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***************************************************************************/
+
+#include "hhg_lcd_core.h"
+
+// static decl
+
+/**
+ * @brief Init steps shared by 4-bit and 8-bit mode, after the function set.
+ *
+ * @param core The panel.
+ */
+static void hhg_lcd_core_init_common(struct hhg_lcd_core* core);
+
+/**
+ * @brief Sends one byte on the bus.
+ *
+ * @param core The panel.
+ * @param byte The byte to be sent.
+ * @param rs_value HHG_COMMAND_MODE or HHG_DATA_MODE.
+ */
+static void hhg_lcd_core_write(struct hhg_lcd_core* core, u8 byte, bool rs_value);
+
+/**
+ * @brief Sends only the upper nibble of a command, used while the panel is still in 8-bit mode.
+ *
+ * @param core The panel.
+ * @param command The command, its lower nibble is not sent.
+ */
+static void hhg_lcd_core_nibble(struct hhg_lcd_core* core, u8 command);
+
+/**
+ * @brief Sleeps through the backend.
+ *
+ * @param core The panel.
+ * @param min_us Minimum time in microseconds.
+ * @param max_us Maximum time in microseconds.
+ */
+static void hhg_lcd_core_delay(struct hhg_lcd_core* core, unsigned int min_us, unsigned int max_us);
+
+//SHADOW FRAMEBUFFER
+
+/**
+ * @brief Maps a DDRAM address on its position in address counter order.
+ *
+ * @param addr The DDRAM address.
+ * @return The position, HHG_CELL_NONE if the address does not exist.
+ */
+static u8 hhg_lcd_ddram_index(u8 addr);
+
+/**
+ * @brief Maps a DDRAM address on a cell of the shadow framebuffer.
+ *
+ * @param core The panel.
+ * @param addr The DDRAM address.
+ * @param cell Filled with the cell, row after row.
+ * @return `true` if the address is a visible cell, `false` otherwise.
+ */
+static bool hhg_lcd_fb_cell(const struct hhg_lcd_core* core, u8 addr, u8* cell);
+
+/**
+ * @brief Returns where the address counter moves after a char is written.
+ *
+ * @param addr The DDRAM address of the char.
+ * @return The next DDRAM address.
+ */
+static u8 hhg_lcd_addr_next(u8 addr);
+
+//TRANSACTION BUFFERS
+
+/**
+ * @brief Hashes a buffer, FNV-1a so that it builds everywhere.
+ *
+ * @param data The buffer.
+ * @param len The length of the buffer.
+ * @param seed Hash of the previous part of the key.
+ * @return The hash.
+ */
+static u32 hhg_lcd_xact_hash(const void* data, size_t len, u32 seed);
+
+/**
+ * @brief Looks for the encoding of a frame update in the cache, encodes it on a miss.
+ *
+ * @param core The panel.
+ * @param frame The frame to show.
+ * @return The encoding, valid until the next call.
+ */
+static const struct hhg_lcd_xact* hhg_lcd_xact_get(struct hhg_lcd_core* core, const char frame[]);
+
+/**
+ * @brief Compiles the update from the shadow framebuffer to a frame into bus words.
+ *
+ * The cells are visited in address counter order from the counter. The DDRAM address is sent only
+ * when the counter is not already on the next cell to write and cannot get there by writing
+ * again at most HHG_XACT_BRIDGE_MAX known cells.
+ *
+ * @param core The panel, for its geometry.
+ * @param xact The transaction to fill, its key must be already set.
+ */
+static void hhg_lcd_xact_encode(const struct hhg_lcd_core* core, struct hhg_lcd_xact* xact);
+
+//ESCAPE SEQUENCE PARSER
+
+/**
+ * @brief Feeds a chunk of text to the escape sequence parser.
+ *
+ * Supported sequences: ESC[<row>;<col>H (and f) cursor position, ESC[H home,
+ * ESC[<n>K erase in line, ESC[<n>J erase in display, ESC[?25h/l cursor on/off
+ * and ESC[?12h/l blink on/off. '\n' moves at the start of the next row and '\r'
+ * at the start of the current one.
+ *
+ * @param core The panel holding the logical cursor.
+ * @param esc The parser state.
+ * @param frame The frame updated by the chunk.
+ * @param flags The display flags updated by the chunk.
+ * @param buff The chunk to parse.
+ * @param len The length of the chunk.
+ */
+static void hhg_lcd_esc_feed(struct hhg_lcd_core* core, struct hhg_lcd_esc* esc, char frame[], u8* flags, const char* buff, size_t len);
+
+/**
+ * @brief Executes a complete CSI sequence.
+ *
+ * @param core The panel holding the logical cursor.
+ * @param esc The parser state holding the parameters.
+ * @param frame The frame updated by the sequence.
+ * @param flags The display flags updated by the sequence.
+ * @param final The final byte of the sequence.
+ */
+static void hhg_lcd_esc_csi(struct hhg_lcd_core* core, const struct hhg_lcd_esc* esc, char frame[], u8* flags, char final);
+
+/**
+ * @brief Writes a printable char at the logical cursor.
+ *
+ * @param core The panel holding the logical cursor.
+ * @param frame The frame to update.
+ * @param c The char to write.
+ */
+static void hhg_lcd_esc_put(struct hhg_lcd_core* core, char frame[], char c);
+
+//PROTOCOL
+
+bool hhg_lcd_geometry_init(struct hhg_lcd_geometry* geometry, u8 rows, u8 cols, const u8 row_offsets[])
+{
+    bool used[HHG_CELLS_MAX] = { false };
+
+    if(rows < 1 || rows > HHG_ROWS_MAX || cols < 1 || cols > HHG_COLS_MAX || rows * cols > HHG_CELLS_MAX)
+    {
+        return false;
+    }
+
+    geometry->rows = rows;
+    geometry->cols = cols;
+    for(u8 row = 0; row < rows; row++)
+    {
+        //odd rows on the second line, the third and fourth ones continue the first two
+        u8 offset = row_offsets ? row_offsets[row] : (row % 2) * 0x40 + (row / 2) * cols;
+        u8 index = hhg_lcd_ddram_index(offset);
+
+        //a row cannot wrap on the other line
+        if(index == HHG_CELL_NONE || index % HHG_DDRAM_LINE_LEN + cols > HHG_DDRAM_LINE_LEN)
+        {
+            return false;
+        }
+        for(u8 col = 0; col < cols; col++)
+        {
+            if(used[index + col])
+            {
+                return false;
+            }
+            used[index + col] = true;
+        }
+
+        geometry->row_offsets[row] = offset;
+    }
+
+    return true;
+}
+
+void hhg_lcd_core_setup(struct hhg_lcd_core* core, const struct hhg_lcd_core_ops* ops, void* ctx, bool bus_8_bit, const struct hhg_lcd_geometry* geometry)
+{
+    memset(core, 0, sizeof(*core));
+    core->ops = ops;
+    core->ctx = ctx;
+    core->bus_8_bit = bus_8_bit;
+    core->geometry = *geometry;
+    core->cells = geometry->rows * geometry->cols;
+    core->addr = HHG_ADDR_UNKNOWN;
+    core->display_flags = HHG_LCD_DISPLAY_OFF;
+
+    memset(core->ddram_cells, HHG_CELL_NONE, sizeof(core->ddram_cells));
+    for(u8 row = 0; row < geometry->rows; row++)
+    {
+        u8 index = hhg_lcd_ddram_index(geometry->row_offsets[row]);
+        for(u8 col = 0; col < geometry->cols; col++)
+        {
+            core->ddram_cells[index + col] = row * geometry->cols + col;
+        }
+    }
+}
+
+void hhg_lcd_core_power_on(struct hhg_lcd_core* core)
+{
+    //for main timing see manual page 45
+    //for timing and command see table 6 page 24
+
+	hhg_lcd_core_delay(core, 45*1000, 55*1000);	// Wait for more than 40 ms
+
+    //initializing by instruction, figure 23 and 24: the three function sets bring the panel to
+    //8-bit mode from any state, a panel left in 4-bit mode by a previous load included
+    hhg_lcd_core_resync(core);
+
+    hhg_lcd_core_init_common(core);
+}
+
+void hhg_lcd_core_init_common(struct hhg_lcd_core* core)
+{
+	hhg_lcd_core_set_flags(core, HHG_LCD_DISPLAY_OFF);
+	hhg_lcd_core_delay(core, 150, 200);
+
+    hhg_lcd_core_clear(core);
+	hhg_lcd_core_delay(core, 150, 200);
+
+	hhg_lcd_core_command(core, 0x06);		/* Entry mode set, instruction 01(I/D)S -> 0110b
+					   Set I/D = 1, or increment or decrement DDRAM address by 1
+					   Set S = 0, or no display shift
+					*/
+	hhg_lcd_core_delay(core, 150, 200);
+
+    hhg_lcd_core_set_flags(core, HHG_LCD_DISPLAY_ON);
+}
+
+void hhg_lcd_core_resync(struct hhg_lcd_core* core)
+{
+    //three function sets in 8-bit mode, see manual page 45
+    if(core->bus_8_bit)
+    {
+        hhg_lcd_core_command(core, 0x30);
+        hhg_lcd_core_delay(core, 5*1000, 6*1000);
+        hhg_lcd_core_command(core, 0x30);
+        hhg_lcd_core_delay(core, 150, 200);
+        hhg_lcd_core_command(core, 0x30);
+        hhg_lcd_core_delay(core, 150, 200);
+
+        hhg_lcd_core_command(core, 0x38);		// Function set (Interface is 8 bits long, 2 lines)
+    }
+    else
+    {
+        //if the panel was waiting for a lower nibble the first one completes a harmless instruction
+        hhg_lcd_core_nibble(core, 0x30);
+        hhg_lcd_core_delay(core, 5*1000, 6*1000);
+        hhg_lcd_core_nibble(core, 0x30);
+        hhg_lcd_core_delay(core, 150, 200);
+        hhg_lcd_core_nibble(core, 0x30);
+        hhg_lcd_core_delay(core, 150, 200);
+
+        hhg_lcd_core_nibble(core, 0x20);		// Function set, 4 bits long from now on
+        hhg_lcd_core_command(core, 0x28);		// Function set (Interface is 4 bits long, 2 lines)
+    }
+	hhg_lcd_core_delay(core, 150, 200);
+}
+
+void hhg_lcd_core_warm(struct hhg_lcd_core* core, bool restore)
+{
+    hhg_lcd_core_resync(core);
+
+	hhg_lcd_core_command(core, 0x06);		// Entry mode set
+
+    if(restore)
+    {
+        //the display control as it was, still off while blanked
+        hhg_lcd_core_redraw(core);
+        hhg_lcd_core_set_flags(core, core->display_flags);
+        hhg_lcd_core_show_cursor(core);
+        return;
+    }
+
+    hhg_lcd_core_clear(core);
+    hhg_lcd_core_set_flags(core, core->display_flags | HHG_LCD_DISPLAY_ON);
+}
+
+void hhg_lcd_core_write(struct hhg_lcd_core* core, u8 byte, bool rs_value)
+{
+    u16 word = rs_value == HHG_DATA_MODE ? HHG_WORD_DATA(byte) : HHG_WORD_CMD(byte);
+
+    //clear display 0x01 and return home 0x02 run far longer than the other instructions
+    if(rs_value == HHG_COMMAND_MODE && byte >= 0x01 && byte <= 0x03)
+    {
+        word |= HHG_WORD_DELAY_LONG;
+    }
+
+    core->ops->replay(core->ctx, &word, 1);
+}
+
+void hhg_lcd_core_nibble(struct hhg_lcd_core* core, u8 command)
+{
+    const u16 word = HHG_WORD_CMD_NIBBLE(command);
+
+    core->ops->replay(core->ctx, &word, 1);
+}
+
+void hhg_lcd_core_delay(struct hhg_lcd_core* core, unsigned int min_us, unsigned int max_us)
+{
+    core->ops->delay(core->ctx, min_us, max_us);
+}
+
+void hhg_lcd_core_command(struct hhg_lcd_core* core, u8 command)
+{
+    hhg_lcd_core_write(core, command, HHG_COMMAND_MODE);
+}
+
+void hhg_lcd_core_char(struct hhg_lcd_core* core, char byte)
+{
+    hhg_lcd_core_write(core, byte, HHG_DATA_MODE);
+
+    if(core->addr == HHG_ADDR_UNKNOWN)
+    {
+        return;
+    }
+
+    u8 cell;
+    if(hhg_lcd_fb_cell(core, core->addr, &cell))
+    {
+        core->glass[cell] = byte;
+    }
+
+    core->addr = hhg_lcd_addr_next(core->addr);
+}
+
+void hhg_lcd_core_str(struct hhg_lcd_core* core, const char buff[])
+{
+    if(!buff)
+    {
+        return;
+    }
+
+    struct hhg_lcd_esc esc;
+    hhg_lcd_esc_reset(&esc);
+
+    hhg_lcd_core_stream(core, &esc, buff, strlen(buff), true);
+}
+
+void hhg_lcd_core_clear(struct hhg_lcd_core* core)
+{
+    hhg_lcd_core_command(core, 0x01);
+
+    memset(core->glass, ' ', sizeof(core->glass));
+    core->addr = 0x00;
+}
+
+void hhg_lcd_core_set_flags(struct hhg_lcd_core* core, u8 flags)
+{
+    core->display_flags = flags & 0x07;
+
+    //sent when unblanked
+    if(core->blanked)
+    {
+        return;
+    }
+
+    hhg_lcd_core_command(core, 0x08 | core->display_flags);
+    hhg_lcd_core_delay(core, 45, 55);
+}
+
+void hhg_lcd_core_blank(struct hhg_lcd_core* core, bool blank)
+{
+    if(core->blanked == blank)
+    {
+        return;
+    }
+
+    hhg_lcd_core_command(core, 0x08 | (blank ? HHG_LCD_DISPLAY_OFF : core->display_flags));
+    hhg_lcd_core_delay(core, 45, 55);
+
+    core->blanked = blank;
+}
+
+void hhg_lcd_core_set_addr(struct hhg_lcd_core* core, u8 addr)
+{
+    hhg_lcd_core_command(core, 0x80 | addr);
+
+    core->addr = addr;
+}
+
+void hhg_lcd_core_stream(struct hhg_lcd_core* core, struct hhg_lcd_esc* esc, const char* buff, size_t len, bool new_screen)
+{
+    char frame[HHG_CELLS_MAX];
+    u8 flags = core->display_flags;
+
+    //a stream opening with plain text is a whole new screen, as it has always been,
+    //later chunks continue from the cursor left by the previous one
+    if(new_screen || (esc->opening && len > 0 && buff[0] != HHG_ESC_CHAR))
+    {
+        memset(frame, ' ', core->cells);
+        core->cursor_row = 0;
+        core->cursor_col = 0;
+    }
+    else
+    {
+        hhg_lcd_core_frame(core, frame);
+    }
+    if(len > 0)
+    {
+        esc->opening = false;
+    }
+
+    hhg_lcd_esc_feed(core, esc, frame, &flags, buff, len);
+
+    hhg_lcd_core_flush(core, frame);
+    if(flags != core->display_flags)
+    {
+        hhg_lcd_core_set_flags(core, flags);
+    }
+    hhg_lcd_core_show_cursor(core);
+}
+
+//SHADOW FRAMEBUFFER
+
+u8 hhg_lcd_ddram_index(u8 addr)
+{
+    if(addr < HHG_DDRAM_LINE_LEN)
+    {
+        return addr;
+    }
+    if(addr >= 0x40 && addr < 0x40 + HHG_DDRAM_LINE_LEN)
+    {
+        return addr - 0x40 + HHG_DDRAM_LINE_LEN;
+    }
+    return HHG_CELL_NONE;
+}
+
+u8 hhg_lcd_ddram_addr(u8 index)
+{
+    return index < HHG_DDRAM_LINE_LEN ? index : index - HHG_DDRAM_LINE_LEN + 0x40;
+}
+
+bool hhg_lcd_fb_cell(const struct hhg_lcd_core* core, u8 addr, u8* cell)
+{
+    u8 index = hhg_lcd_ddram_index(addr);
+    if(index == HHG_CELL_NONE || core->ddram_cells[index] == HHG_CELL_NONE)
+    {
+        return false;
+    }
+
+    *cell = core->ddram_cells[index];
+    return true;
+}
+
+u8 hhg_lcd_addr_next(u8 addr)
+{
+    //in two lines mode the address counter jumps from the end of a line to the start of the other one
+    return hhg_lcd_ddram_addr((hhg_lcd_ddram_index(addr) + 1) % HHG_CELLS_MAX);
+}
+
+void hhg_lcd_core_flush(struct hhg_lcd_core* core, const char frame[])
+{
+    const struct hhg_lcd_xact* xact = hhg_lcd_xact_get(core, frame);
+
+    if(xact->words_count > 0)
+    {
+        core->ops->replay(core->ctx, xact->words, xact->words_count);
+    }
+
+    for(u8 i = 0; i < core->cells; i++)
+    {
+        if(frame[i] != HHG_CELL_KEEP)
+        {
+            core->glass[i] = frame[i];
+        }
+    }
+    core->addr = xact->addr_after;
+}
+
+void hhg_lcd_core_frame(const struct hhg_lcd_core* core, char frame[])
+{
+    for(u8 cell = 0; cell < core->cells; cell++)
+    {
+        frame[cell] = core->glass[cell] == HHG_CELL_KEEP ? ' ' : core->glass[cell];
+    }
+}
+
+void hhg_lcd_core_redraw(struct hhg_lcd_core* core)
+{
+    char frame[HHG_CELLS_MAX];
+
+    hhg_lcd_core_frame(core, frame);
+
+    //no cell of the shadow matches any more, every cell is written
+    memset(core->glass, HHG_CELL_KEEP, sizeof(core->glass));
+    core->addr = HHG_ADDR_UNKNOWN;
+
+    hhg_lcd_core_flush(core, frame);
+}
+
+void hhg_lcd_core_show_cursor(struct hhg_lcd_core* core)
+{
+    if(!(core->display_flags & (HHG_LCD_CURSOR_ON | HHG_LCD_BLINK_ON)))
+    {
+        return;
+    }
+
+    u8 row = min_t(u8, core->cursor_row, core->geometry.rows - 1);
+    u8 col = min_t(u8, core->cursor_col, core->geometry.cols - 1);
+    u8 addr = core->geometry.row_offsets[row] + col;
+    if(core->addr != addr)
+    {
+        hhg_lcd_core_set_addr(core, addr);
+    }
+}
+
+//TRANSACTION BUFFERS
+
+u32 hhg_lcd_xact_hash(const void* data, size_t len, u32 seed)
+{
+    const u8* bytes = data;
+    u32 hash = seed ^ 2166136261u;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+const struct hhg_lcd_xact* hhg_lcd_xact_get(struct hhg_lcd_core* core, const char frame[])
+{
+    u32 hash = hhg_lcd_xact_hash(core->glass, core->cells, core->addr);
+    hash = hhg_lcd_xact_hash(frame, core->cells, hash);
+
+    for(u8 i = 0; i < HHG_XACT_CACHE_SIZE; i++)
+    {
+        struct hhg_lcd_xact* xact = &core->xact_cache[i];
+        if(xact->valid
+            && xact->hash == hash
+            && xact->addr_before == core->addr
+            && memcmp(xact->glass, core->glass, core->cells) == 0
+            && memcmp(xact->frame, frame, core->cells) == 0)
+        {
+            return xact;
+        }
+    }
+
+    struct hhg_lcd_xact* xact = &core->xact_scratch;
+    xact->valid = false;
+    xact->hash = hash;
+    xact->addr_before = core->addr;
+    memcpy(xact->glass, core->glass, core->cells);
+    memcpy(xact->frame, frame, core->cells);
+
+    hhg_lcd_xact_encode(core, xact);
+
+    //nothing to send, not worth a slot: the cached encodings are kept
+    if(xact->words_count == 0)
+    {
+        return xact;
+    }
+
+    struct hhg_lcd_xact* slot = &core->xact_cache[core->xact_cache_next];
+    core->xact_cache_next = (core->xact_cache_next + 1) % HHG_XACT_CACHE_SIZE;
+
+    *slot = *xact;
+    slot->valid = true;
+
+    return slot;
+}
+
+void hhg_lcd_xact_encode(const struct hhg_lcd_core* core, struct hhg_lcd_xact* xact)
+{
+    u8 addr = xact->addr_before;
+    u8 start = hhg_lcd_ddram_index(addr);
+    u16 count = 0;
+
+    //on 4 rows panels the address counter runs row 1, row 3, row 2, row 4
+    if(start == HHG_CELL_NONE)
+    {
+        start = 0;
+    }
+    for(u8 i = 0; i < HHG_CELLS_MAX; i++)
+    {
+        u8 index = (start + i) % HHG_CELLS_MAX;
+        u8 cell = core->ddram_cells[index];
+        if(cell == HHG_CELL_NONE)
+        {
+            continue;
+        }
+
+        char c = xact->frame[cell];
+        if(c == HHG_CELL_KEEP || xact->glass[cell] == c)
+        {
+            continue;
+        }
+
+        u8 cell_addr = hhg_lcd_ddram_addr(index);
+        if(addr != cell_addr)
+        {
+            //the cells in between are unchanged, written again when they are few and known
+            u8 from = hhg_lcd_ddram_index(addr);
+            u8 gap = from == HHG_CELL_NONE ? HHG_CELL_NONE : (index + HHG_CELLS_MAX - from) % HHG_CELLS_MAX;
+            bool bridge = gap <= HHG_XACT_BRIDGE_MAX;
+            for(u8 j = 0; bridge && j < gap; j++)
+            {
+                u8 skipped = core->ddram_cells[(from + j) % HHG_CELLS_MAX];
+                bridge = skipped != HHG_CELL_NONE && xact->glass[skipped] != HHG_CELL_KEEP;
+            }
+
+            if(bridge)
+            {
+                for(u8 j = 0; j < gap; j++)
+                {
+                    xact->words[count++] = HHG_WORD_DATA(xact->glass[core->ddram_cells[(from + j) % HHG_CELLS_MAX]]);
+                }
+            }
+            else
+            {
+                xact->words[count++] = HHG_WORD_CMD(0x80 | cell_addr);   // Set DDRAM address
+            }
+        }
+        xact->words[count++] = HHG_WORD_DATA(c);
+        addr = hhg_lcd_addr_next(cell_addr);
+    }
+
+    xact->addr_after = addr;
+    xact->words_count = count;
+}
+
+//ESCAPE SEQUENCE PARSER
+
+void hhg_lcd_esc_reset(struct hhg_lcd_esc* esc)
+{
+    memset(esc, 0, sizeof(*esc));
+    esc->state = HHG_ESC_GROUND;
+    esc->opening = true;
+}
+
+void hhg_lcd_esc_feed(struct hhg_lcd_core* core, struct hhg_lcd_esc* esc, char frame[], u8* flags, const char* buff, size_t len)
+{
+    for(size_t i = 0; i < len; i++)
+    {
+        char c = buff[i];
+
+        switch (esc->state)
+        {
+        case HHG_ESC_GROUND:
+            if(c == HHG_ESC_CHAR)
+            {
+                esc->state = HHG_ESC_ESCAPE;
+            }
+            else if(c == '\n')
+            {
+                if(core->cursor_row < core->geometry.rows)
+                {
+                    core->cursor_row++;
+                }
+                core->cursor_col = 0;
+            }
+            else if(c == '\r')
+            {
+                core->cursor_col = 0;
+            }
+            else if(c != '\0')
+            {
+                hhg_lcd_esc_put(core, frame, c);
+            }
+            break;
+        case HHG_ESC_ESCAPE:
+            if(c == '[')
+            {
+                memset(esc->params, 0, sizeof(esc->params));
+                esc->param_index = 0;
+                esc->private_mode = false;
+                esc->state = HHG_ESC_CSI;
+            }
+            else
+            {
+                esc->state = HHG_ESC_GROUND;
+            }
+            break;
+        case HHG_ESC_CSI:
+            if(c >= '0' && c <= '9')
+            {
+                u16* param = &esc->params[esc->param_index];
+                *param = min_t(u16, *param * 10 + (c - '0'), HHG_ESC_MAX_PARAM_VALUE);
+            }
+            else if(c == ';')
+            {
+                if(esc->param_index < HHG_ESC_MAX_PARAMS - 1)
+                {
+                    esc->param_index++;
+                }
+            }
+            else if(c == '?')
+            {
+                esc->private_mode = true;
+            }
+            else if(c >= 0x40 && c <= 0x7E)
+            {
+                hhg_lcd_esc_csi(core, esc, frame, flags, c);
+                esc->state = HHG_ESC_GROUND;
+            }
+            else if(c < 0x20)
+            {
+                //control char in the middle of a sequence, drop it
+                esc->state = HHG_ESC_GROUND;
+            }
+            break;
+        default:
+            esc->state = HHG_ESC_GROUND;
+            break;
+        }
+    }
+}
+
+void hhg_lcd_esc_csi(struct hhg_lcd_core* core, const struct hhg_lcd_esc* esc, char frame[], u8* flags, char final)
+{
+    const u8 rows = core->geometry.rows;
+    const u8 cols = core->geometry.cols;
+    u16 row = min_t(u8, core->cursor_row, rows - 1);
+    u16 col = min_t(u8, core->cursor_col, cols - 1);
+    u16 from, to;
+    u8 flag = 0;
+
+    if(esc->private_mode)
+    {
+        if(esc->params[0] == 25)
+        {
+            flag = HHG_LCD_CURSOR_ON;
+        }
+        else if(esc->params[0] == 12)
+        {
+            flag = HHG_LCD_BLINK_ON;
+        }
+
+        if(final == 'h')
+        {
+            *flags |= flag;
+        }
+        else if(final == 'l')
+        {
+            *flags &= ~flag;
+        }
+        return;
+    }
+
+    switch (final)
+    {
+    case 'H':
+    case 'f':
+        //1-based, 0 or omitted means the first one
+        core->cursor_row = esc->params[0] ? min_t(u16, esc->params[0], rows) - 1 : 0;
+        core->cursor_col = esc->params[1] ? min_t(u16, esc->params[1], cols) - 1 : 0;
+        break;
+    case 'K':
+        from = esc->params[0] == 0 ? col : 0;
+        to = esc->params[0] == 1 ? col + 1 : cols;
+        memset(&frame[row * cols + from], ' ', to - from);
+        break;
+    case 'J':
+        from = esc->params[0] == 0 ? row * cols + col : 0;
+        to = esc->params[0] == 1 ? row * cols + col + 1 : rows * cols;
+        memset(&frame[from], ' ', to - from);
+        break;
+    default:
+        break;
+    }
+}
+
+void hhg_lcd_esc_put(struct hhg_lcd_core* core, char frame[], char c)
+{
+    //pending wrap, the previous char filled the row
+    if(core->cursor_col >= core->geometry.cols && core->cursor_row < core->geometry.rows)
+    {
+        core->cursor_row++;
+        core->cursor_col = 0;
+    }
+
+    if(core->cursor_row >= core->geometry.rows)
+    {
+        return;
+    }
+
+    frame[core->cursor_row * core->geometry.cols + core->cursor_col++] = c;
+}
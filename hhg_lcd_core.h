@@ -0,0 +1,344 @@
+/***************************************************************************
+ *
+ * Hi Happy Garden LCD HITACHI HD44780U
+ * Copyright (C) 2023  Antonio Salsi <passy.linux@zresa.it>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***************************************************************************/
+
+#ifndef _HHG_LCD_CORE_H_
+#define _HHG_LCD_CORE_H_
+
+// Portable core: HD44780 protocol, screen layout and refresh.
+// Built in the kernel module and in the userspace backends, the bus access is left to them.
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+#define min_t(type, x, y) ((type)(x) < (type)(y) ? (type)(x) : (type)(y))
+#endif
+
+#define HHG_ROWS_DEFAULT (2)
+#define HHG_COLS_DEFAULT (16)
+#define HHG_ROWS_MAX (4)
+#define HHG_COLS_MAX (40)
+#define HHG_CELLS_MAX (80)  // DDRAM size, no geometry has more cells
+#define HHG_FRAME_MAX_LEN (HHG_CELLS_MAX + HHG_ROWS_MAX)  // text of the largest glass, a '\n' after each row
+
+#define HHG_CELL_KEEP ('\0')  // cell of a frame left untouched
+#define HHG_CELL_NONE (0xFF)  // DDRAM address not shown on the glass
+
+#define HHG_DDRAM_LINE_LEN (0x28)  // in two lines mode DDRAM is 0x00-0x27 and 0x40-0x67
+
+
+#define HHG_COMMAND_MODE (0)
+#define HHG_DATA_MODE (1)
+
+//Sets entire display (D) on/off,
+// cursor on/off (C), and
+// blinking of cursor position
+// character (B).
+enum hhg_lcd_flag
+{
+    HHG_LCD_DISPLAY_OFF = 0x00,
+    HHG_LCD_BLINK_ON    = 0x01,
+    HHG_LCD_CURSOR_ON   = 0x02,
+    HHG_LCD_DISPLAY_ON  = 0x04
+};
+
+#define HHG_ADDR_UNKNOWN (0xFF)
+
+#define HHG_WORD_RS (0x100)  // bus word flag, RS high for data
+#define HHG_WORD_DELAY_EXEC (0x200)  // bus word flag, wait for the previous instruction before the transfer
+#define HHG_WORD_NIBBLE (0x400)  // bus word flag, only the upper nibble on DB4-DB7, the panel is still 8 bits long
+#define HHG_WORD_DELAY_LONG (0x800)  // bus word flag, clear or return home, wait for it after the transfer
+#define HHG_WORD_CMD(byte) ((u16)(u8)(byte) | HHG_WORD_DELAY_EXEC)
+#define HHG_WORD_DATA(byte) ((u16)(u8)(byte) | HHG_WORD_RS)
+#define HHG_WORD_CMD_NIBBLE(byte) (HHG_WORD_CMD(byte) | HHG_WORD_NIBBLE)
+
+#define HHG_EXEC_MIN_US (1000)  // wait for the previous instruction
+#define HHG_EXEC_MAX_US (1500)
+#define HHG_EXEC_LONG_MIN_US (1600)  // clear and return home take 1.52 ms
+#define HHG_EXEC_LONG_MAX_US (2000)
+#define HHG_DATA_MIN_US (45)  // a write to DDRAM takes 37 us plus 4 us to update the address counter
+#define HHG_DATA_MAX_US (55)
+
+#define HHG_XACT_MAX_WORDS (2 * HHG_CELLS_MAX)  // a set address and a char for each cell in the worst case
+#define HHG_XACT_BRIDGE_MAX (2)  // unchanged cells written again rather than sending a set address, that waits for the previous instruction
+#define HHG_XACT_CACHE_SIZE (4)
+#define HHG_ESC_CHAR ('\x1b')
+#define HHG_ESC_MAX_PARAMS (2)
+#define HHG_ESC_MAX_PARAM_VALUE (999)
+
+enum hhg_lcd_esc_state
+{
+    HHG_ESC_GROUND,
+    HHG_ESC_ESCAPE,
+    HHG_ESC_CSI,
+};
+
+// State of the escape sequence parser, kept across writes
+struct hhg_lcd_esc
+{
+    enum hhg_lcd_esc_state state;  ///< Current parser state.
+    u16 params[HHG_ESC_MAX_PARAMS];  ///< Numeric parameters of the CSI sequence, 0 when omitted.
+    u8 param_index;  ///< Parameter being parsed.
+    bool private_mode;  ///< CSI sequence introduced by '?'.
+    bool opening;  ///< No chunk parsed since the reset, plain text starts a new screen.
+};
+
+// Frame update compiled to bus words
+struct hhg_lcd_xact
+{
+    bool valid;  ///< The slot holds an encoding.
+    u32 hash;  ///< Hash of the key: address counter, shadow framebuffer and frame.
+    u8 addr_before;  ///< Address counter before the update.
+    u8 addr_after;  ///< Address counter after the update.
+    char glass[HHG_CELLS_MAX];  ///< Shadow framebuffer before the update.
+    char frame[HHG_CELLS_MAX];  ///< Requested frame.
+    u16 words_count;  ///< Number of bus words.
+    u16 words[HHG_XACT_MAX_WORDS];  ///< Bus words ready to be replayed.
+};
+
+// Bus access provided by the backend
+struct hhg_lcd_core_ops
+{
+    /**
+     * @brief Sends bus words in order.
+     *
+     * Before a word with HHG_WORD_DELAY_EXEC the backend waits for the previous instruction,
+     * at least HHG_EXEC_MIN_US, before any other word at least HHG_DATA_MIN_US. After a word
+     * with HHG_WORD_DELAY_LONG it waits at least HHG_EXEC_LONG_MIN_US. A word with
+     * HHG_WORD_NIBBLE sends only its upper nibble on DB4-DB7.
+     */
+    void (*replay)(void* ctx, const u16 words[], u16 count);
+
+    /**
+     * @brief Sleeps for the given range of microseconds.
+     */
+    void (*delay)(void* ctx, unsigned int min_us, unsigned int max_us);
+};
+
+// Layout of the glass on DDRAM
+struct hhg_lcd_geometry
+{
+    u8 rows;  ///< Rows of the glass.
+    u8 cols;  ///< Columns of the glass.
+    u8 row_offsets[HHG_ROWS_MAX];  ///< DDRAM address of the first cell of each row.
+};
+
+// One panel: its shadow framebuffer, logical cursor and transaction cache
+struct hhg_lcd_core
+{
+    const struct hhg_lcd_core_ops* ops;  ///< Bus access.
+    void* ctx;  ///< Context passed to the ops.
+    bool bus_8_bit;  ///< Data bus wired on 8 pins.
+    struct hhg_lcd_geometry geometry;  ///< Layout of the glass.
+    u8 cells;  ///< Cells of the glass, rows * cols.
+    u8 ddram_cells[HHG_CELLS_MAX];  ///< Cell shown at each DDRAM address in address counter order, HHG_CELL_NONE if hidden.
+    char glass[HHG_CELLS_MAX];  ///< Content of the panel DDRAM, row after row.
+    u8 addr;  ///< DDRAM address counter of the panel.
+    u8 cursor_row;  ///< Row of the logical cursor, rows when past the last row.
+    u8 cursor_col;  ///< Column of the logical cursor, cols when a wrap is pending.
+    u8 display_flags;  ///< Last flags set with hhg_lcd_core_set_flags().
+    bool blanked;  ///< Display switched off by hhg_lcd_core_blank(), DDRAM and display_flags kept.
+    struct hhg_lcd_xact xact_cache[HHG_XACT_CACHE_SIZE];  ///< Recent encodings, alternating frames are encoded once.
+    u8 xact_cache_next;  ///< Next slot to recycle.
+    struct hhg_lcd_xact xact_scratch;  ///< Encoding of a missed update, cached only if it sends something.
+};
+
+// The core is not reentrant, all the calls on one panel must be serialized by the backend.
+
+/**
+ * @brief Fills and checks a geometry.
+ *
+ * Without a table the rows start at 0x00, 0x40, cols and 0x40 + cols, as on 16x4 and 20x4 panels.
+ *
+ * @param geometry The geometry to fill.
+ * @param rows Rows of the glass, 1 to HHG_ROWS_MAX.
+ * @param cols Columns of the glass, 1 to HHG_COLS_MAX.
+ * @param row_offsets DDRAM address of the first cell of each row, NULL for the usual layout.
+ * @return `true` if every row fits in a DDRAM line without overlapping the others, `false` otherwise.
+ */
+bool hhg_lcd_geometry_init(struct hhg_lcd_geometry* geometry, u8 rows, u8 cols, const u8 row_offsets[]);
+
+/**
+ * @brief Sets up a panel, nothing is sent on the bus.
+ *
+ * @param core The panel.
+ * @param ops The bus access.
+ * @param ctx Context passed to the ops.
+ * @param bus_8_bit `true` if the data bus is wired on 8 pins.
+ * @param geometry The layout of the glass, checked by hhg_lcd_geometry_init().
+ */
+void hhg_lcd_core_setup(struct hhg_lcd_core* core, const struct hhg_lcd_core_ops* ops, void* ctx, bool bus_8_bit, const struct hhg_lcd_geometry* geometry);
+
+/**
+ * @brief Power-on init sequence, see manual page 45, ends with a blank screen and the display on.
+ *
+ * @param core The panel.
+ */
+void hhg_lcd_core_power_on(struct hhg_lcd_core* core);
+
+/**
+ * @brief Puts the interface back in the configured data mode without the power-on waits.
+ *
+ * Works whatever nibble a 4-bit interface was waiting for.
+ *
+ * @param core The panel.
+ */
+void hhg_lcd_core_resync(struct hhg_lcd_core* core);
+
+/**
+ * @brief Warm start of a panel already initialized and in a known state.
+ *
+ * @param core The panel.
+ * @param restore `true` to redraw the shadow framebuffer with the display flags and cursor it had,
+ *                `false` to start from a blank screen with the display on.
+ */
+void hhg_lcd_core_warm(struct hhg_lcd_core* core, bool restore);
+
+/**
+ * @brief Sends a command, the shadow framebuffer is not updated.
+ *
+ * @param core The panel.
+ * @param command The command to be sent.
+ */
+void hhg_lcd_core_command(struct hhg_lcd_core* core, u8 command);
+
+/**
+ * @brief Sends a char at the address counter.
+ *
+ * @param core The panel.
+ * @param byte The char to be sent.
+ */
+void hhg_lcd_core_char(struct hhg_lcd_core* core, char byte);
+
+/**
+ * @brief Lays out a string on a blank screen from the first cell.
+ *
+ * @param core The panel.
+ * @param buff The string, can be NULL.
+ */
+void hhg_lcd_core_str(struct hhg_lcd_core* core, const char buff[]);
+
+/**
+ * @brief Clears the display.
+ *
+ * @param core The panel.
+ */
+void hhg_lcd_core_clear(struct hhg_lcd_core* core);
+
+/**
+ * @brief Sets the display flags, see enum hhg_lcd_flag.
+ *
+ * @param core The panel.
+ * @param flags The flags to be set.
+ */
+void hhg_lcd_core_set_flags(struct hhg_lcd_core* core, u8 flags);
+
+/**
+ * @brief Switches the display off keeping the DDRAM, or back on with display_flags.
+ *
+ * While blanked the writes keep updating the DDRAM and hhg_lcd_core_set_flags() only records
+ * the flags, so switching back on is a single instruction.
+ *
+ * @param core The panel.
+ * @param blank `true` to switch the display off, `false` to switch it back on.
+ */
+void hhg_lcd_core_blank(struct hhg_lcd_core* core, bool blank);
+
+/**
+ * @brief Sets the DDRAM address.
+ *
+ * @param core The panel.
+ * @param addr The DDRAM address.
+ */
+void hhg_lcd_core_set_addr(struct hhg_lcd_core* core, u8 addr);
+
+/**
+ * @brief Maps a position in address counter order on its DDRAM address.
+ *
+ * @param index The position, as in ddram_cells.
+ * @return The DDRAM address.
+ */
+u8 hhg_lcd_ddram_addr(u8 index);
+
+/**
+ * @brief Parses a chunk of a text stream and shows it.
+ *
+ * @param core The panel.
+ * @param esc The parser state, kept across calls.
+ * @param buff The chunk to parse.
+ * @param len The length of the chunk.
+ * @param new_screen `true` to lay out the chunk on a blank screen from the first cell,
+ *                   otherwise only a first chunk starting with plain text does.
+ */
+void hhg_lcd_core_stream(struct hhg_lcd_core* core, struct hhg_lcd_esc* esc, const char* buff, size_t len, bool new_screen);
+
+/**
+ * @brief Writes all the cells of a frame differing from the shadow framebuffer.
+ *
+ * The update is compiled to bus words once, or taken from the transaction cache, and then replayed.
+ * Cells are written in address counter order, so that the interleaved rows of 4 rows panels
+ * make one run, and short runs of unchanged cells are written again instead of moving the counter.
+ *
+ * @param core The panel.
+ * @param frame The frame to show, rows * cols cells row after row, HHG_CELL_KEEP cells are left untouched.
+ */
+void hhg_lcd_core_flush(struct hhg_lcd_core* core, const char frame[]);
+
+/**
+ * @brief Copies the shadow framebuffer as the base of a new frame.
+ *
+ * The cells no longer known are blanks in the frame, so that a flush of it writes them again.
+ *
+ * @param core The panel.
+ * @param frame The frame, rows * cols cells row after row.
+ */
+void hhg_lcd_core_frame(const struct hhg_lcd_core* core, char frame[]);
+
+/**
+ * @brief Writes again the whole shadow framebuffer, the content of the panel is unknown.
+ *
+ * @param core The panel.
+ */
+void hhg_lcd_core_redraw(struct hhg_lcd_core* core);
+
+/**
+ * @brief Moves the address counter on the logical cursor when the cursor is visible.
+ *
+ * @param core The panel.
+ */
+void hhg_lcd_core_show_cursor(struct hhg_lcd_core* core);
+
+/**
+ * @brief Resets the escape sequence parser, the next chunk is the first one of the stream.
+ *
+ * @param esc The parser state.
+ */
+void hhg_lcd_esc_reset(struct hhg_lcd_esc* esc);
+
+#endif
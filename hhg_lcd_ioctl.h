@@ -0,0 +1,53 @@
+/***************************************************************************
+ * 
+ * Hi Happy Garden LCD HITACHI HD44780U
+ * Copyright (C) 2023  Antonio Salsi <passy.linux@zresa.it>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. 
+ * 
+ ***************************************************************************/
+
+#ifndef _HHG_LCD_IOCTL_H_
+#define _HHG_LCD_IOCTL_H_
+
+// Shared with userspace, include it as it is from applications
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define HHG_LCD_IOC_MAGIC ('h')
+
+#define HHG_LCD_ANIM_MAX_FRAMES (1024)
+
+enum hhg_lcd_anim_flag
+{
+    HHG_LCD_ANIM_LOOP    = 0x01,  // restart from the first frame after the last one
+    HHG_LCD_ANIM_OVERLAY = 0x02   // keep playing over regular writes instead of being cancelled by them
+};
+
+// Animation uploaded with HHG_LCD_IOC_ANIM_PLAY
+struct hhg_lcd_anim
+{
+    __u32 frames_count;     // number of frames, at most HHG_LCD_ANIM_MAX_FRAMES
+    __u32 cells_per_frame;  // rows * columns of the display
+    __u32 flags;            // see enum hhg_lcd_anim_flag
+    __u32 reserved;         // must be 0
+    __u64 durations;        // pointer to frames_count __u32, time on the glass of each frame in ms
+    __u64 cells;            // pointer to frames_count * cells_per_frame chars, row after row,
+                            // a 0 cell leaves the previous content so a frame can be a delta
+};
+
+#define HHG_LCD_IOC_ANIM_PLAY _IOW(HHG_LCD_IOC_MAGIC, 1, struct hhg_lcd_anim)
+#define HHG_LCD_IOC_ANIM_STOP _IO(HHG_LCD_IOC_MAGIC, 2)
+
+#endif
@@ -0,0 +1,2634 @@
+/***************************************************************************
+ * 
+ * Hi Happy Garden LCD HITACHI HD44780U
+ * Copyright (C) 2023  Antonio Salsi <passy.linux@zresa.it>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. 
+ * 
+ ***************************************************************************/
+
+#include "hhg_lcd.h"
+#include "hhg_lcd_core.h"
+#include "hhg_lcd_ioctl.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/gpio.h>
+#include <linux/delay.h>
+#include <linux/string.h>
+#include <linux/cdev.h>
+#include <linux/jump_label.h>
+#include <linux/llist.h>
+#include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/mutex.h>
+#include <uapi/linux/sched/types.h>
+#include <linux/completion.h>
+#include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/fs.h>
+#include <linux/timer.h>
+#include <linux/jiffies.h>
+#include <linux/pm.h>
+
+#ifdef pr_fmt
+#undef pr_fmt
+#define pr_fmt(fmt) "hhg_lcd: " fmt
+#endif
+
+#ifndef HHG_BUS_WIDTH
+#define HHG_BUS_WIDTH (0)  ///< 4 or 8 to build only that transfer path, 0 to pick it at load time from the configured pins
+#endif
+
+#define HHG_DB_FIRST_8_BIT (0)  ///< First data pin wired in 8-bit mode.
+#define HHG_DB_FIRST_4_BIT (4)  ///< First data pin wired in 4-bit mode.
+
+#define HHG_STREAM_MAX_LEN (PAGE_SIZE)
+#define HHG_FIELDS_MAX (16)
+#define HHG_BUSY_POLL_MAX (100)  ///< Busy flag reads before giving up, longer than the 1.52 ms of clear.
+
+#define HHG_IS_VALID(gpio, msg) \
+if (!gpio_is_valid(gpio)) \
+{ \
+    pr_err("GPIO " msg " wrong pin:%d", gpio); \
+    return -EINVAL; \
+} 
+
+//LCD MANAGEMENT
+
+#if HHG_BUS_WIDTH == 0
+static DEFINE_STATIC_KEY_FALSE(data_mode_8_bit);  ///< Patched at init, no branch per byte.
+#endif
+
+static short gpio_rs  = -1;
+static short gpio_en  = -1;
+static short gpio_rw  = -1;
+static short gpio_db0  = -1;
+static short gpio_db1  = -1;
+static short gpio_db2  = -1;
+static short gpio_db3  = -1;
+static short gpio_db4  = -1;
+static short gpio_db5  = -1;
+static short gpio_db6  = -1;
+static short gpio_db7  = -1;
+
+static bool warm_start = false;  ///< Skip the power-on reset sequence, the panel is already initialized.
+
+static u8 rows = HHG_ROWS_DEFAULT;
+static u8 cols = HHG_COLS_DEFAULT;
+static u8 row_offsets[HHG_ROWS_MAX];  ///< DDRAM address of the first cell of each row, the usual layout when not set.
+static unsigned int row_offsets_count = 0;
+static struct hhg_lcd_geometry lcd_geometry;  ///< Layout of the glass, checked at load.
+
+static short* const gpio_db[] = { &gpio_db0, &gpio_db1, &gpio_db2, &gpio_db3, &gpio_db4, &gpio_db5, &gpio_db6, &gpio_db7 };  ///< Data pins, DB0 first.
+
+static unsigned long bus_transfers = 0;  ///< EN pulses since load, written only by the bus owner.
+
+//SHADOW FRAMEBUFFER, owned by the bus owner
+
+static struct hhg_lcd_core lcd_core;  ///< Protocol, shadow framebuffer and refresh of the panel.
+
+// static decl
+
+/**
+ * @brief Initializes the LCD in 8-bit mode.
+ *
+ * This function initializes the LCD in 8-bit mode.
+ *
+ * @return `true` if the initialization was successful, `false` otherwise.
+ */
+static bool hhg_lcd_init(void);
+
+/**
+ * @brief Initializes the LCD in 8-bit mode.
+ *
+ * This function initializes the LCD in 8-bit mode.
+ *
+ * @return `true` if the initialization was successful, `false` otherwise.
+ */
+static bool hhg_lcd_init_8_bit(void);
+
+/**
+ * @brief Initializes the LCD in 4-bit mode.
+ *
+ * This function initializes the LCD in 4-bit mode.
+ *
+ * @return `true` if the initialization was successful, `false` otherwise.
+ */
+static bool hhg_lcd_init_4_bit(void);
+
+/**
+ * @brief Brings up the panel, run by the bus owner as first command.
+ *
+ * Full power-on sequence, or warm start when the warm_start parameter is set.
+ */
+static void hhg_lcd_panel_init(void);
+
+/**
+ * @brief Tells if the bus is 8-bit wide.
+ *
+ * Folded at compile time when the module is built for one bus width.
+ *
+ * @return `true` for 8-bit mode, `false` for 4-bit mode.
+ */
+static __always_inline bool hhg_lcd_is_8_bit(void);
+
+/**
+ * @brief Sets up RS, EN and the wired data pins.
+ *
+ * @param first_db First wired data pin, HHG_DB_FIRST_8_BIT or HHG_DB_FIRST_4_BIT.
+ * @return `true` if the operation was successful, `false` otherwise.
+ */
+static bool hhg_lcd_pins_setup(u8 first_db);
+
+
+/**
+ * @brief Frees the pin used by the HHG LCD.
+ *
+ * This function frees the specified GPIO pin used by the HHG LCD.
+ *
+ * @param gpio_number The GPIO pin number to be freed.
+ */
+static void hhg_lcd_pin_free(u8 gpio_number);
+
+/**
+ * @brief Initializes the LCD in 4-bit mode.
+ * 
+ */
+static void hhg_lcd_free(void);
+
+/**
+ * @brief Sets up the pin for the HHG LCD.
+ *
+ * This function sets up the specified GPIO pin for the HHG LCD.
+ *
+ * @param gpio_number The GPIO pin number to be set up.
+ * @param gpio_direction The direction of the GPIO pin (input or output).
+ * @return `true` if the operation was successful, `false` otherwise.
+ */
+static bool hhg_lcd_pin_setup(u8 gpio_number, u8 gpio_direction);
+
+/**
+ * @brief Puts bits on a run of data pins and pulses EN.
+ *
+ * With constant pins it unrolls into straight GPIO writes.
+ *
+ * @param value The bits, the first one goes on first_db.
+ * @param first_db First data pin.
+ * @param count Number of data pins.
+ * @param rs_value HHG_COMMAND_MODE or HHG_DATA_MODE.
+ */
+static __always_inline void hhg_lcd_xfer_bits(u8 value, const u8 first_db, const u8 count, bool rs_value);
+
+/**
+ * @brief Generic transfer core, sends one byte on a bus of the given width.
+ *
+ * The wait for the previous instruction is up to the caller.
+ *
+ * Each call with a constant width is specialized into the 4-bit or 8-bit path.
+ *
+ * @param byte The byte to be sent.
+ * @param rs_value HHG_COMMAND_MODE or HHG_DATA_MODE.
+ * @param width 4 or 8.
+ */
+static __always_inline void hhg_lcd_xfer(u8 byte, bool rs_value, const u8 width);
+
+/**
+ * @brief Sends one pre-encoded bus word.
+ *
+ * @param word The data bits, HHG_WORD_RS, HHG_WORD_NIBBLE and the delay classes HHG_WORD_DELAY_EXEC
+ *             and HHG_WORD_DELAY_LONG.
+ */
+static void hhg_lcd_bus_emit(u16 word);
+
+/**
+ * @brief Sends a pre-encoded transaction, no encoding is done on the way.
+ *
+ * Core op, must be called only by the bus owner.
+ *
+ * @param ctx Unused.
+ * @param words The bus words.
+ * @param count The number of bus words.
+ */
+static void hhg_lcd_bus_replay(void* ctx, const u16 words[], u16 count);
+
+/**
+ * @brief Sleeps between the steps of a core sequence.
+ *
+ * Core op, must be called only by the bus owner.
+ *
+ * @param ctx Unused.
+ * @param min_us Minimum time in microseconds.
+ * @param max_us Maximum time in microseconds.
+ */
+static void hhg_lcd_bus_delay(void* ctx, unsigned int min_us, unsigned int max_us);
+
+static const struct hhg_lcd_core_ops bus_ops = {
+    .replay = hhg_lcd_bus_replay,
+    .delay = hhg_lcd_bus_delay,
+};
+
+/**
+ * @brief Selects the row to write on the bus.
+ *
+ * Must be called only by the bus owner.
+ *
+ * @param row The row number to select.
+ */
+static void hhg_lcd_bus_select_row(enum hhg_row row);
+
+//COMMAND QUEUE
+
+enum hhg_lcd_cmd_type
+{
+    HHG_CMD_COMMAND,
+    HHG_CMD_CHAR,
+    HHG_CMD_STR,
+    HHG_CMD_CLEAR,
+    HHG_CMD_SELECT_ROW,
+    HHG_CMD_SET_FLAGS,
+    HHG_CMD_STREAM,
+    HHG_CMD_FRAME,
+    HHG_CMD_ANIM_START,
+    HHG_CMD_ANIM_STEP,
+    HHG_CMD_ANIM_STOP,
+    HHG_CMD_INIT,
+    HHG_CMD_VERIFY,
+    HHG_CMD_VERIFY_STOP,
+    HHG_CMD_IDLE,
+    HHG_CMD_IDLE_STOP,
+    HHG_CMD_SUSPEND,
+    HHG_CMD_RESUME,
+};
+
+struct hhg_lcd_cmd
+{
+    struct llist_node node;  ///< Link in the command queue.
+    enum hhg_lcd_cmd_type type;  ///< Operation to execute on the bus.
+    u8 arg;  ///< Command, char, row or flags argument.
+    u32 flags;  ///< Submission flags, see enum hhg_lcd_submit_flag.
+    hhg_lcd_callback callback;  ///< Called when the command is on the bus, can be NULL.
+    void* ctx;  ///< Context passed to the callback.
+    struct hhg_lcd_esc* esc;  ///< Parser state for HHG_CMD_STREAM.
+    size_t len;  ///< Length of the HHG_CMD_STREAM chunk.
+    struct hhg_lcd_anim_player* anim;  ///< Animation for HHG_CMD_ANIM_START.
+    u32 generation;  ///< Animation generation for HHG_CMD_ANIM_STEP.
+    char str[];  ///< String argument for HHG_CMD_STR, chunk for HHG_CMD_STREAM, cells for HHG_CMD_FRAME.
+};
+
+static LLIST_HEAD(cmd_queue);  ///< Lock-free multi producer queue drained by the bus owner.
+static struct task_struct* bus_thread;  ///< Bus owner thread.
+static unsigned int bus_priority = 1;  ///< SCHED_FIFO priority of the bus owner, 0 for SCHED_NORMAL.
+static char* bus_cpus = NULL;  ///< CPUs the bus owner can run on as cpulist, NULL for all.
+static DEFINE_MUTEX(bus_config_lock);  ///< Serializes the changes of priority and affinity.
+
+/**
+ * @brief Bus owner thread, sleeps until commands are queued and drains them.
+ *
+ * This is the only context that touches the GPIOs after init.
+ *
+ * @param data Unused.
+ * @return Always 0.
+ */
+static int hhg_lcd_bus_thread_fn(void* data);
+
+/**
+ * @brief Executes all the commands in the queue.
+ */
+static void hhg_lcd_bus_drain(void);
+
+/**
+ * @brief Sets the scheduling priority of the bus owner.
+ *
+ * @param priority SCHED_FIFO priority from 1 to MAX_RT_PRIO - 1, 0 for SCHED_NORMAL.
+ * @return 0 on success, or an error code.
+ */
+static int hhg_lcd_bus_set_priority(unsigned int priority);
+
+/**
+ * @brief Sets the CPUs the bus owner can run on.
+ *
+ * @param cpulist The CPUs as cpulist, for instance "2-3".
+ * @return 0 on success, or an error code.
+ */
+static int hhg_lcd_bus_set_cpus(const char* cpulist);
+
+/**
+ * @brief Allocates a command for the queue.
+ *
+ * @param type The operation to execute.
+ * @param arg The operation argument.
+ * @param str_len Extra room for a string argument.
+ * @param gfp Allocation flags, GFP_ATOMIC when called from atomic context.
+ * @return The command, NULL if out of memory.
+ */
+static struct hhg_lcd_cmd* hhg_lcd_cmd_alloc(enum hhg_lcd_cmd_type type, u8 arg, size_t str_len, gfp_t gfp);
+
+/**
+ * @brief Queues a command without waiting.
+ *
+ * The command is freed by the bus owner, safe from atomic and IRQ context.
+ *
+ * @param cmd The command to queue.
+ */
+static void hhg_lcd_cmd_queue(struct hhg_lcd_cmd* cmd);
+
+/**
+ * @brief Queues a command and waits until the bus owner has executed it.
+ *
+ * The command is freed by the bus owner. Called by the bus owner itself, from a completion
+ * callback, the command is dropped with a warning.
+ *
+ * @param cmd The command to submit.
+ */
+static void hhg_lcd_cmd_submit(struct hhg_lcd_cmd* cmd);
+
+/**
+ * @brief Runs a command without argument on the bus owner and waits for it.
+ *
+ * @param type The operation to execute.
+ * @return 0 on success, -ENOMEM on failure.
+ */
+static int hhg_lcd_cmd_run(enum hhg_lcd_cmd_type type);
+
+/**
+ * @brief Queues a command without argument from a timer callback.
+ *
+ * Out of memory the timer fires again on the next tick.
+ *
+ * @param type The operation to execute.
+ * @param timer The expired timer.
+ * @param generation Generation of the animation, 0 for the other commands.
+ */
+static void hhg_lcd_cmd_timer_fn(enum hhg_lcd_cmd_type type, struct timer_list* timer, u32 generation);
+
+/**
+ * @brief Arms a timer, at least one jiffy from now.
+ *
+ * @param timer The timer.
+ * @param ms The delay in ms.
+ */
+static void hhg_lcd_timer_arm(struct timer_list* timer, unsigned int ms);
+
+/**
+ * @brief Callback used by hhg_lcd_cmd_submit() to wake up the submitter.
+ *
+ * @param ctx Pointer to the completion to signal.
+ * @param status Ignored.
+ */
+static void hhg_lcd_cmd_complete(void* ctx, int status);
+
+/**
+ * @brief Executes one command on the bus.
+ *
+ * @param cmd The command to execute.
+ */
+static void hhg_lcd_cmd_exec(const struct hhg_lcd_cmd* cmd);
+
+/**
+ * @brief Sends a raw command and updates the address counter and the shadow framebuffer after it.
+ *
+ * Clear, home, display control and set DDRAM address are decoded, the commands moving the
+ * address counter or the content of the glass in other ways leave them unknown: the next stream
+ * write, readback or resume writes every cell again, blank unless the write sets it. Display
+ * control only updates the flags while the display is blanked.
+ *
+ * @param command The command byte.
+ */
+static void hhg_lcd_cmd_raw(u8 command);
+
+//ANIMATION PLAYER, owned by the bus owner
+
+struct hhg_lcd_anim_player
+{
+    u32 frames_count;  ///< Number of frames.
+    u32 flags;  ///< See enum hhg_lcd_anim_flag.
+    u32 frame;  ///< Next frame to show.
+    u32* durations;  ///< Time on the glass of each frame in ms.
+    char* cells;  ///< Frames, rows * cols cells each.
+};
+
+static struct hhg_lcd_anim_player* anim_player = NULL;  ///< Animation playing, NULL if none.
+static u32 anim_generation = 0;  ///< Bumped on stop, discards the steps of the old animation still queued.
+
+/**
+ * @brief Timer callback, queues the next step of the animation.
+ *
+ * @param timer Pointer to the timer.
+ */
+static void hhg_lcd_anim_timer_fn(struct timer_list* timer);
+
+static DEFINE_TIMER(anim_timer, hhg_lcd_anim_timer_fn);
+
+/**
+ * @brief Starts an animation, stopping the one playing.
+ *
+ * @param anim The animation, owned by the player from now on.
+ */
+static void hhg_lcd_anim_start(struct hhg_lcd_anim_player* anim);
+
+/**
+ * @brief Shows the next frame of the animation and arms the timer for the following one.
+ *
+ * @param generation The generation of the animation the step was queued for.
+ */
+static void hhg_lcd_anim_step(u32 generation);
+
+/**
+ * @brief Stops the animation playing, if any.
+ */
+static void hhg_lcd_anim_stop(void);
+
+/**
+ * @brief Stops the animation playing if a command of the given type has to cancel it.
+ *
+ * @param type The type of the command about to be executed.
+ */
+static void hhg_lcd_anim_preempt(enum hhg_lcd_cmd_type type);
+
+/**
+ * @brief Frees an animation.
+ *
+ * @param anim The animation to free, can be NULL.
+ */
+static void hhg_lcd_anim_free(struct hhg_lcd_anim_player* anim);
+
+/**
+ * @brief Stops the animation playing and waits for it.
+ *
+ * @return 0 on success, -ENOMEM on failure.
+ */
+static int hhg_lcd_anim_cancel(void);
+
+//DDRAM READBACK, owned by the bus owner
+
+static unsigned int verify_ms = 0;  ///< Period of the readback check, 0 to disable.
+static bool verify_enabled = false;  ///< Check running, cleared on stop to drop the checks still queued.
+
+/**
+ * @brief Timer callback, queues a readback check.
+ *
+ * @param timer Pointer to the timer.
+ */
+static void hhg_lcd_verify_timer_fn(struct timer_list* timer);
+
+static DEFINE_TIMER(verify_timer, hhg_lcd_verify_timer_fn);
+
+/**
+ * @brief Pulses EN with R/W high and samples a run of data pins.
+ *
+ * @param first_db First data pin.
+ * @param count Number of data pins.
+ * @return The bits, the first one from first_db.
+ */
+static u8 hhg_lcd_read_bits(const u8 first_db, const u8 count);
+
+/**
+ * @brief Turns the data pins to inputs and raises R/W, R/W must be wired.
+ *
+ * Must be called only by the bus owner, no write is possible until hhg_lcd_bus_read_end().
+ */
+static void hhg_lcd_bus_read_begin(void);
+
+/**
+ * @brief Lowers R/W and turns the data pins back to outputs.
+ */
+static void hhg_lcd_bus_read_end(void);
+
+/**
+ * @brief Reads one byte from the bus, between hhg_lcd_bus_read_begin() and hhg_lcd_bus_read_end().
+ *
+ * @param rs_value HHG_COMMAND_MODE for busy flag and address counter, HHG_DATA_MODE for DDRAM.
+ * @return The byte read.
+ */
+static u8 hhg_lcd_bus_read(bool rs_value);
+
+/**
+ * @brief Polls the busy flag until the previous instruction is done.
+ *
+ * @param addr Set to the address counter.
+ * @return `false` if the flag is still set after HHG_BUSY_POLL_MAX reads.
+ */
+static bool hhg_lcd_bus_ready(u8* addr);
+
+/**
+ * @brief Starts the periodic readback check if R/W is wired and a period is set.
+ */
+static void hhg_lcd_verify_start(void);
+
+/**
+ * @brief Reads back the DDRAM and rewrites the cells differing from the shadow framebuffer.
+ *
+ * A 4-bit interface out of step is resynchronized first.
+ */
+static void hhg_lcd_verify(void);
+
+/**
+ * @brief Tells if the address counter reads back the address just set.
+ *
+ * @return `false` if the interface is out of step.
+ */
+static bool hhg_lcd_verify_interface(void);
+
+/**
+ * @brief Stops the periodic readback check.
+ */
+static void hhg_lcd_verify_stop(void);
+
+/**
+ * @brief Stops the periodic readback check and waits for it.
+ *
+ * @return 0 on success, -ENOMEM on failure.
+ */
+static int hhg_lcd_verify_cancel(void);
+
+//IDLE BLANKING, owned by the bus owner
+
+static unsigned int idle_ms = 0;  ///< Time without writes before the display is switched off, 0 to disable.
+static bool idle_enabled = false;  ///< Timer armed by the writes, cleared on stop to drop the idle commands still queued.
+static bool suspend_blanked = false;  ///< Display already off by idle when the system went to sleep.
+static bool suspended = false;  ///< System asleep, the display stays off and the timers are stopped until resume.
+
+/**
+ * @brief Timer callback, queues the switch off of the display.
+ *
+ * @param timer Pointer to the timer.
+ */
+static void hhg_lcd_idle_timer_fn(struct timer_list* timer);
+
+static DEFINE_TIMER(idle_timer, hhg_lcd_idle_timer_fn);
+
+/**
+ * @brief Arms the idle timer if a timeout is set.
+ */
+static void hhg_lcd_idle_start(void);
+
+/**
+ * @brief Switches the display back on and arms the idle timer again after a write.
+ *
+ * @param type The type of the command just executed.
+ */
+static void hhg_lcd_idle_touch(enum hhg_lcd_cmd_type type);
+
+/**
+ * @brief Switches the display off, the DDRAM is kept.
+ */
+static void hhg_lcd_idle(void);
+
+/**
+ * @brief Stops the idle timer.
+ */
+static void hhg_lcd_idle_stop(void);
+
+/**
+ * @brief Stops the idle timer and waits for it.
+ *
+ * @return 0 on success, -ENOMEM on failure.
+ */
+static int hhg_lcd_idle_cancel(void);
+
+/**
+ * @brief Switches the display off before the system sleeps, remembering if idle had already done it.
+ *
+ * The animation, readback and idle timers are stopped, writes still update the DDRAM in the dark.
+ */
+static void hhg_lcd_bus_suspend(void);
+
+/**
+ * @brief Brings the panel back after the system sleep, in the state it had before.
+ *
+ * The timers stopped on suspend are armed again.
+ */
+static void hhg_lcd_bus_resume(void);
+
+/**
+ * @brief System sleep callback, runs hhg_lcd_bus_suspend() on the bus owner and waits for it.
+ *
+ * The bus owner is not freezable, it still runs while the devices are suspended.
+ */
+static int __maybe_unused hhg_lcd_pm_suspend(struct device* dev);
+
+/**
+ * @brief System wake callback, runs hhg_lcd_bus_resume() on the bus owner and waits for it.
+ */
+static int __maybe_unused hhg_lcd_pm_resume(struct device* dev);
+
+static SIMPLE_DEV_PM_OPS(hhg_lcd_pm_ops, hhg_lcd_pm_suspend, hhg_lcd_pm_resume);
+
+bool hhg_lcd_init(void)
+{
+    bool pins_8_bit;
+
+    if(
+        gpio_db0 > -1
+        && gpio_db1 > -1
+        && gpio_db2 > -1
+        && gpio_db3 > -1
+        && gpio_db4 > -1
+        && gpio_db5 > -1
+        && gpio_db6 > -1
+        && gpio_db7 > -1
+      )
+    {
+        pins_8_bit = true;
+    }
+    else  if(
+        gpio_db0 == -1
+        && gpio_db1 == -1
+        && gpio_db2 == -1
+        && gpio_db3 == -1
+        && gpio_db4 > -1
+        && gpio_db5 > -1
+        && gpio_db6 > -1
+        && gpio_db7 > -1
+      )
+    {
+        pins_8_bit = false;
+    }
+    else
+    {
+        pr_err("number of configured pins not suitable for 4-bit or 8-bit configuration");
+        return false;
+    }
+
+#if HHG_BUS_WIDTH == 4
+    if(pins_8_bit)
+    {
+        pr_err("module built for 4-bit data mode only");
+        return false;
+    }
+#elif HHG_BUS_WIDTH == 8
+    if(!pins_8_bit)
+    {
+        pr_err("module built for 8-bit data mode only");
+        return false;
+    }
+#else
+    if(pins_8_bit)
+    {
+        static_branch_enable(&data_mode_8_bit);
+    }
+#endif
+
+    if(gpio_rs == -1)
+    {
+        pr_err("GPIO RS mandatory");
+        return false;
+    }
+
+    if(gpio_en == -1)
+    {
+        pr_err("GPIO RS mandatory");
+        return false;
+    }
+
+    if(verify_ms > 0 && gpio_rw == -1)
+    {
+        pr_warn("verify_ms needs gpio_rw, readback disabled");
+    }
+
+    hhg_lcd_core_setup(&lcd_core, &bus_ops, NULL, hhg_lcd_is_8_bit(), &lcd_geometry);
+
+    if(!hhg_lcd_pins_setup(hhg_lcd_is_8_bit() ? HHG_DB_FIRST_8_BIT : HHG_DB_FIRST_4_BIT))
+    {
+        pr_err("Init %u bit data error", hhg_lcd_is_8_bit() ? 8 : 4);
+        return false;
+    }
+
+    //the panel comes up in the bus owner, module load does not wait for it and writes queue behind it
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_INIT, 0, 0, GFP_KERNEL);
+    if(!cmd)
+    {
+        hhg_lcd_free();
+        return false;
+    }
+    hhg_lcd_cmd_queue(cmd);
+
+    return true;
+}
+
+void hhg_lcd_panel_init(void)
+{
+    if(warm_start)
+    {
+        hhg_lcd_core_warm(&lcd_core, false);
+        pr_info("warm start done");
+    }
+    else if(hhg_lcd_is_8_bit())
+    {
+        hhg_lcd_init_8_bit();
+    }
+    else
+    {
+        hhg_lcd_init_4_bit();
+    }
+
+    hhg_lcd_verify_start();
+    hhg_lcd_idle_start();
+}
+
+bool hhg_lcd_init_8_bit(void)
+{
+    pr_info("init 8 bit data mode done"
+    " gpio_rs:%d"
+    " gpio_en:%d"
+    " gpio_db0:%d"
+    " gpio_db1:%d"
+    " gpio_db2:%d"
+    " gpio_db3:%d"
+    " gpio_db4:%d"
+    " gpio_db5:%d"
+    " gpio_db6:%d"
+    " gpio_db7:%d"
+    , gpio_rs
+    , gpio_en
+    , gpio_db0
+    , gpio_db1
+    , gpio_db2
+    , gpio_db3
+    , gpio_db4
+    , gpio_db5
+    , gpio_db6
+    , gpio_db7
+    );
+
+    hhg_lcd_core_power_on(&lcd_core);
+
+    return true;
+}
+
+bool hhg_lcd_init_4_bit(void)
+{
+    pr_info("init 4 bit data mode done"
+    " gpio_rs:%d"
+    " gpio_en:%d"
+    " gpio_db4:%d"
+    " gpio_db5:%d"
+    " gpio_db6:%d"
+    " gpio_db7:%d"
+    , gpio_rs
+    , gpio_en
+    , gpio_db4
+    , gpio_db5
+    , gpio_db6
+    , gpio_db7
+    );
+
+    hhg_lcd_core_power_on(&lcd_core);
+
+    return true;
+}
+
+bool hhg_lcd_is_8_bit(void)
+{
+#if HHG_BUS_WIDTH == 4
+    return false;
+#elif HHG_BUS_WIDTH == 8
+    return true;
+#else
+    return static_branch_unlikely(&data_mode_8_bit);
+#endif
+}
+
+bool hhg_lcd_pins_setup(u8 first_db)
+{
+    if(!hhg_lcd_pin_setup(gpio_rs, 0))
+    {
+        pr_err("Error to set gpio_rs");
+        return false;
+    }
+    if(!hhg_lcd_pin_setup(gpio_en, 0))
+    {
+        pr_err("Error to set gpio_en");
+        return false;
+    }
+    //R/W is optional, held low for write when wired
+    if(gpio_rw > -1 && !hhg_lcd_pin_setup(gpio_rw, 0))
+    {
+        pr_err("Error to set gpio_rw");
+        return false;
+    }
+    for(u8 i = first_db; i < ARRAY_SIZE(gpio_db); i++)
+    {
+        if(!hhg_lcd_pin_setup(*gpio_db[i], 0))
+        {
+            pr_err("Error to set gpio_db%u", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline static void hhg_lcd_pin_free(u8 gpio_number)
+{
+    gpio_unexport(gpio_number);
+    gpio_free(gpio_number);
+}
+
+static void hhg_lcd_free(void)
+{
+    hhg_lcd_pin_free(gpio_rs);
+    hhg_lcd_pin_free(gpio_en);
+    if(gpio_rw > -1)
+    {
+        hhg_lcd_pin_free(gpio_rw);
+    }
+    for(u8 i = hhg_lcd_is_8_bit() ? HHG_DB_FIRST_8_BIT : HHG_DB_FIRST_4_BIT; i < ARRAY_SIZE(gpio_db); i++)
+    {
+        hhg_lcd_pin_free(*gpio_db[i]);
+    }
+}
+
+bool hhg_lcd_pin_setup(u8 gpio_number, u8 gpio_direction)
+{
+	u8 ret;
+
+	ret = gpio_request( gpio_number, "GPIO request");
+	if( ret != 0 )	{
+		pr_err("failed to request GPIO %d \n", gpio_number );
+		return false;
+	}	
+	
+	ret = gpio_export( gpio_number, 0);
+	if( ret != 0 )	{
+		pr_err("failed to export GPIO %d \n", gpio_number );
+		return false;
+	}
+
+	ret = gpio_direction_output( gpio_number, gpio_direction);
+	if( ret != 0 )	{
+		pr_err("failed to set GPIO direction %d \n", gpio_number );	
+		return false;
+	}
+
+	gpio_set_value(gpio_number, 0);
+
+	return true; 
+}
+
+
+void hhg_lcd_xfer_bits(u8 value, const u8 first_db, const u8 count, bool rs_value)
+{
+    for(u8 i = 0; i < count; i++)
+    {
+        gpio_set_value(*gpio_db[first_db + i], (value >> i) & 0x01);
+    }
+
+    gpio_set_value(gpio_rs, rs_value);
+    usleep_range(5, 10);
+
+	gpio_set_value(gpio_en, 1);
+	usleep_range(5, 10);
+	gpio_set_value(gpio_en, 0);
+
+    WRITE_ONCE(bus_transfers, bus_transfers + 1);
+}
+
+void hhg_lcd_xfer(u8 byte, bool rs_value, const u8 width)
+{
+    if(width == 8)
+    {
+        hhg_lcd_xfer_bits(byte, HHG_DB_FIRST_8_BIT, 8, rs_value);
+    }
+    else
+    {
+        //the EN cycle of the upper nibble is all the panel needs before the lower one
+        hhg_lcd_xfer_bits(byte >> 4, HHG_DB_FIRST_4_BIT, 4, rs_value);     // upper
+        hhg_lcd_xfer_bits(byte & 0x0F, HHG_DB_FIRST_4_BIT, 4, rs_value);   // lower
+    }
+}
+
+void hhg_lcd_bus_emit(u16 word)
+{
+    if(word & HHG_WORD_DELAY_EXEC)
+    {
+        usleep_range(HHG_EXEC_MIN_US, HHG_EXEC_MAX_US);   // previous instruction done
+    }
+    else
+    {
+        usleep_range(HHG_DATA_MIN_US, HHG_DATA_MAX_US);   // previous write done
+    }
+
+    if(word & HHG_WORD_NIBBLE)
+    {
+        hhg_lcd_xfer_bits(word >> 4, HHG_DB_FIRST_4_BIT, 4, HHG_COMMAND_MODE);
+    }
+    else if(hhg_lcd_is_8_bit())
+    {
+        hhg_lcd_xfer(word, word & HHG_WORD_RS, 8);
+    }
+    else
+    {
+        hhg_lcd_xfer(word, word & HHG_WORD_RS, 4);
+    }
+
+    if(word & HHG_WORD_DELAY_LONG)
+    {
+        usleep_range(HHG_EXEC_LONG_MIN_US, HHG_EXEC_LONG_MAX_US);   // clear or return home done
+    }
+}
+
+void hhg_lcd_bus_replay(void* ctx, const u16 words[], u16 count)
+{
+    for(u16 i = 0; i < count; i++)
+    {
+        hhg_lcd_bus_emit(words[i]);
+    }
+}
+
+void hhg_lcd_bus_delay(void* ctx, unsigned int min_us, unsigned int max_us)
+{
+    usleep_range(min_us, max_us);
+}
+
+void hhg_lcd_bus_select_row(enum hhg_row row)
+{
+    if(row >= HHG_FIRST_ROW && row <= lcd_geometry.rows)
+    {
+        hhg_lcd_core_set_addr(&lcd_core, lcd_geometry.row_offsets[row - 1]);
+    }
+}
+
+//COMMAND QUEUE
+
+struct hhg_lcd_cmd* hhg_lcd_cmd_alloc(enum hhg_lcd_cmd_type type, u8 arg, size_t str_len, gfp_t gfp)
+{
+    struct hhg_lcd_cmd* cmd = kmalloc(sizeof(*cmd) + str_len, gfp);
+    if(!cmd)
+    {
+        pr_err("cannot allocate command");
+        return NULL;
+    }
+
+    cmd->type = type;
+    cmd->arg = arg;
+    cmd->flags = HHG_LCD_SUBMIT_DEFAULT;
+    cmd->callback = NULL;
+    cmd->ctx = NULL;
+    cmd->esc = NULL;
+    cmd->len = str_len;
+    cmd->anim = NULL;
+    cmd->generation = 0;
+
+    return cmd;
+}
+
+void hhg_lcd_cmd_queue(struct hhg_lcd_cmd* cmd)
+{
+    //llist_add() is lock-free and safe against concurrent producers,
+    //the producer finding the queue empty wakes up the bus owner
+    if(llist_add(&cmd->node, &cmd_queue))
+    {
+        wake_up_process(bus_thread);
+    }
+}
+
+void hhg_lcd_cmd_submit(struct hhg_lcd_cmd* cmd)
+{
+    DECLARE_COMPLETION_ONSTACK(done);
+
+    //from a completion callback the bus owner would wait for itself
+    if(WARN_ON(current == bus_thread))
+    {
+        kfree(cmd);
+        return;
+    }
+
+    cmd->callback = hhg_lcd_cmd_complete;
+    cmd->ctx = &done;
+
+    hhg_lcd_cmd_queue(cmd);
+
+    wait_for_completion(&done);
+}
+
+void hhg_lcd_cmd_complete(void* ctx, int status)
+{
+    complete(ctx);
+}
+
+int hhg_lcd_cmd_run(enum hhg_lcd_cmd_type type)
+{
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(type, 0, 0, GFP_KERNEL);
+    if(!cmd)
+    {
+        return -ENOMEM;
+    }
+
+    hhg_lcd_cmd_submit(cmd);
+
+    return 0;
+}
+
+void hhg_lcd_cmd_timer_fn(enum hhg_lcd_cmd_type type, struct timer_list* timer, u32 generation)
+{
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(type, 0, 0, GFP_ATOMIC);
+    if(!cmd)
+    {
+        //try again on the next tick
+        mod_timer(timer, jiffies + 1);
+        return;
+    }
+
+    cmd->generation = generation;
+    hhg_lcd_cmd_queue(cmd);
+}
+
+void hhg_lcd_timer_arm(struct timer_list* timer, unsigned int ms)
+{
+    mod_timer(timer, jiffies + max_t(unsigned long, msecs_to_jiffies(ms), 1));
+}
+
+void hhg_lcd_cmd_exec(const struct hhg_lcd_cmd* cmd)
+{
+    hhg_lcd_anim_preempt(cmd->type);
+
+    switch (cmd->type)
+    {
+    case HHG_CMD_COMMAND:
+        hhg_lcd_cmd_raw(cmd->arg);
+        break;
+    case HHG_CMD_CHAR:
+        hhg_lcd_core_char(&lcd_core, cmd->arg);
+        break;
+    case HHG_CMD_STR:
+        hhg_lcd_core_str(&lcd_core, cmd->str);
+        break;
+    case HHG_CMD_CLEAR:
+        hhg_lcd_core_clear(&lcd_core);
+        break;
+    case HHG_CMD_SELECT_ROW:
+        hhg_lcd_bus_select_row(cmd->arg);
+        break;
+    case HHG_CMD_SET_FLAGS:
+        hhg_lcd_core_set_flags(&lcd_core, cmd->arg);
+        break;
+    case HHG_CMD_STREAM:
+        hhg_lcd_core_stream(&lcd_core, cmd->esc, cmd->str, cmd->len, false);
+        break;
+    case HHG_CMD_FRAME:
+        hhg_lcd_core_flush(&lcd_core, cmd->str);
+        hhg_lcd_core_show_cursor(&lcd_core);
+        break;
+    case HHG_CMD_ANIM_START:
+        hhg_lcd_anim_start(cmd->anim);
+        break;
+    case HHG_CMD_ANIM_STEP:
+        hhg_lcd_anim_step(cmd->generation);
+        break;
+    case HHG_CMD_ANIM_STOP:
+        hhg_lcd_anim_stop();
+        break;
+    case HHG_CMD_INIT:
+        hhg_lcd_panel_init();
+        break;
+    case HHG_CMD_VERIFY:
+        hhg_lcd_verify();
+        break;
+    case HHG_CMD_VERIFY_STOP:
+        hhg_lcd_verify_stop();
+        break;
+    case HHG_CMD_IDLE:
+        hhg_lcd_idle();
+        break;
+    case HHG_CMD_IDLE_STOP:
+        hhg_lcd_idle_stop();
+        break;
+    case HHG_CMD_SUSPEND:
+        hhg_lcd_bus_suspend();
+        break;
+    case HHG_CMD_RESUME:
+        hhg_lcd_bus_resume();
+        break;
+    default:
+        break;
+    }
+
+    hhg_lcd_idle_touch(cmd->type);
+}
+
+void hhg_lcd_cmd_raw(u8 command)
+{
+    if((command & 0xF8) == 0x08)
+    {
+        //display on/off control, the flags idle wake and resume bring back, not sent while blanked
+        hhg_lcd_core_set_flags(&lcd_core, command & 0x07);
+        return;
+    }
+
+    hhg_lcd_core_command(&lcd_core, command);
+
+    if(command == 0x01)
+    {
+        //clear display
+        memset(lcd_core.glass, ' ', sizeof(lcd_core.glass));
+        lcd_core.addr = 0x00;
+    }
+    else if((command & 0xFE) == 0x02)
+    {
+        //return home, DDRAM is untouched
+        lcd_core.addr = 0x00;
+    }
+    else if(command & 0x80)
+    {
+        //set DDRAM address
+        lcd_core.addr = command & 0x7F;
+    }
+    else if((command & 0xF8) == 0x10 || command >= 0x20)
+    {
+        //cursor shift, function set or CGRAM address, the glass is untouched
+        lcd_core.addr = HHG_ADDR_UNKNOWN;
+    }
+    else if(command == 0x06)
+    {
+        //entry mode as the driver sets it, increment without shift, nothing changes
+    }
+    else
+    {
+        //display shift, or entry mode decrementing or shifting: what the glass shows no longer
+        //follows the shadow framebuffer, its cells are blanks for the next write and for read()
+        memset(lcd_core.glass, HHG_CELL_KEEP, sizeof(lcd_core.glass));
+        lcd_core.addr = HHG_ADDR_UNKNOWN;
+    }
+}
+
+int hhg_lcd_bus_thread_fn(void* data)
+{
+    for(;;)
+    {
+        set_current_state(TASK_INTERRUPTIBLE);
+        if(llist_empty(&cmd_queue))
+        {
+            //stop only once the queue is drained
+            if(kthread_should_stop())
+            {
+                __set_current_state(TASK_RUNNING);
+                break;
+            }
+            schedule();
+            continue;
+        }
+        __set_current_state(TASK_RUNNING);
+
+        hhg_lcd_bus_drain();
+    }
+
+    return 0;
+}
+
+void hhg_lcd_bus_drain(void)
+{
+    //the queue is LIFO, restore the submission order before executing
+    struct llist_node* list = llist_reverse_order(llist_del_all(&cmd_queue));
+    struct hhg_lcd_cmd* cmd;
+    struct hhg_lcd_cmd* tmp;
+    struct hhg_lcd_cmd* last_replace = NULL;
+
+    //only the newest replaceable frame of the batch reaches the glass
+    llist_for_each_entry_safe(cmd, tmp, list, node)
+    {
+        if(cmd->flags & HHG_LCD_SUBMIT_REPLACE)
+        {
+            last_replace = cmd;
+        }
+    }
+
+    llist_for_each_entry_safe(cmd, tmp, list, node)
+    {
+        hhg_lcd_callback callback = cmd->callback;
+        void* ctx = cmd->ctx;
+        int status = 0;
+
+        if((cmd->flags & HHG_LCD_SUBMIT_REPLACE) && cmd != last_replace)
+        {
+            status = -ECANCELED;
+        }
+        else
+        {
+            hhg_lcd_cmd_exec(cmd);
+        }
+        kfree(cmd);
+
+        if(callback)
+        {
+            callback(ctx, status);
+        }
+    }
+}
+
+int hhg_lcd_bus_set_priority(unsigned int priority)
+{
+    struct sched_attr attr = {
+        .size = sizeof(attr),
+        .sched_policy = priority ? SCHED_FIFO : SCHED_NORMAL,
+        .sched_priority = priority,
+    };
+
+    if(priority >= MAX_RT_PRIO)
+    {
+        return -EINVAL;
+    }
+
+    mutex_lock(&bus_config_lock);
+    int ret = sched_setattr_nocheck(bus_thread, &attr);
+    if(ret == 0)
+    {
+        bus_priority = priority;
+    }
+    mutex_unlock(&bus_config_lock);
+
+    return ret;
+}
+
+int hhg_lcd_bus_set_cpus(const char* cpulist)
+{
+    cpumask_var_t cpus;
+    int ret;
+
+    if(!alloc_cpumask_var(&cpus, GFP_KERNEL))
+    {
+        return -ENOMEM;
+    }
+
+    ret = cpulist_parse(cpulist, cpus);
+    if(ret == 0 && !cpumask_intersects(cpus, cpu_online_mask))
+    {
+        ret = -EINVAL;
+    }
+
+    if(ret == 0)
+    {
+        mutex_lock(&bus_config_lock);
+        ret = set_cpus_allowed_ptr(bus_thread, cpus);
+        mutex_unlock(&bus_config_lock);
+    }
+
+    free_cpumask_var(cpus);
+    return ret;
+}
+
+//ANIMATION PLAYER
+
+void hhg_lcd_anim_timer_fn(struct timer_list* timer)
+{
+    hhg_lcd_cmd_timer_fn(HHG_CMD_ANIM_STEP, timer, READ_ONCE(anim_generation));
+}
+
+void hhg_lcd_anim_start(struct hhg_lcd_anim_player* anim)
+{
+    hhg_lcd_anim_stop();
+
+    anim->frame = 0;
+    anim_player = anim;
+
+    hhg_lcd_anim_step(anim_generation);
+}
+
+void hhg_lcd_anim_step(u32 generation)
+{
+    struct hhg_lcd_anim_player* anim = anim_player;
+
+    //while suspended the animation holds its frame, resume steps it again
+    if(!anim || generation != anim_generation || suspended)
+    {
+        return;
+    }
+
+    if(anim->frame >= anim->frames_count)
+    {
+        if(!(anim->flags & HHG_LCD_ANIM_LOOP))
+        {
+            hhg_lcd_anim_stop();
+            return;
+        }
+        anim->frame = 0;
+    }
+
+    //frames are deltas, only the changed cells reach the bus
+    hhg_lcd_core_flush(&lcd_core, &anim->cells[anim->frame * lcd_core.cells]);
+    hhg_lcd_core_show_cursor(&lcd_core);
+
+    hhg_lcd_timer_arm(&anim_timer, anim->durations[anim->frame]);
+    anim->frame++;
+}
+
+void hhg_lcd_anim_stop(void)
+{
+    if(!anim_player)
+    {
+        return;
+    }
+
+    del_timer_sync(&anim_timer);
+    WRITE_ONCE(anim_generation, anim_generation + 1);
+
+    hhg_lcd_anim_free(anim_player);
+    anim_player = NULL;
+}
+
+void hhg_lcd_anim_preempt(enum hhg_lcd_cmd_type type)
+{
+    if(!anim_player || (anim_player->flags & HHG_LCD_ANIM_OVERLAY))
+    {
+        return;
+    }
+
+    switch (type)
+    {
+    case HHG_CMD_SET_FLAGS:
+    case HHG_CMD_ANIM_START:
+    case HHG_CMD_ANIM_STEP:
+    case HHG_CMD_ANIM_STOP:
+    case HHG_CMD_VERIFY:
+    case HHG_CMD_VERIFY_STOP:
+    case HHG_CMD_IDLE:
+    case HHG_CMD_IDLE_STOP:
+    case HHG_CMD_SUSPEND:
+    case HHG_CMD_RESUME:
+        break;
+    default:
+        //a regular write cancels the animation
+        hhg_lcd_anim_stop();
+        break;
+    }
+}
+
+void hhg_lcd_anim_free(struct hhg_lcd_anim_player* anim)
+{
+    if(!anim)
+    {
+        return;
+    }
+
+    kfree(anim->durations);
+    kvfree(anim->cells);
+    kfree(anim);
+}
+
+int hhg_lcd_anim_cancel(void)
+{
+    return hhg_lcd_cmd_run(HHG_CMD_ANIM_STOP);
+}
+
+//DDRAM READBACK
+
+void hhg_lcd_verify_timer_fn(struct timer_list* timer)
+{
+    hhg_lcd_cmd_timer_fn(HHG_CMD_VERIFY, timer, 0);
+}
+
+u8 hhg_lcd_read_bits(const u8 first_db, const u8 count)
+{
+    u8 value = 0;
+
+	gpio_set_value(gpio_en, 1);
+	usleep_range(5, 10);
+    for(u8 i = 0; i < count; i++)
+    {
+        value |= (gpio_get_value(*gpio_db[first_db + i]) & 0x01) << i;
+    }
+	gpio_set_value(gpio_en, 0);
+	usleep_range(5, 10);
+
+    WRITE_ONCE(bus_transfers, bus_transfers + 1);
+
+    return value;
+}
+
+void hhg_lcd_bus_read_begin(void)
+{
+    for(u8 i = hhg_lcd_is_8_bit() ? HHG_DB_FIRST_8_BIT : HHG_DB_FIRST_4_BIT; i < ARRAY_SIZE(gpio_db); i++)
+    {
+        gpio_direction_input(*gpio_db[i]);
+    }
+    gpio_set_value(gpio_rw, 1);
+}
+
+void hhg_lcd_bus_read_end(void)
+{
+    //the panel drives the data pins until R/W is low again
+    gpio_set_value(gpio_rw, 0);
+    for(u8 i = hhg_lcd_is_8_bit() ? HHG_DB_FIRST_8_BIT : HHG_DB_FIRST_4_BIT; i < ARRAY_SIZE(gpio_db); i++)
+    {
+        gpio_direction_output(*gpio_db[i], 0);
+    }
+}
+
+u8 hhg_lcd_bus_read(bool rs_value)
+{
+    u8 byte;
+
+    gpio_set_value(gpio_rs, rs_value);
+    usleep_range(5, 10);
+
+    if(hhg_lcd_is_8_bit())
+    {
+        byte = hhg_lcd_read_bits(HHG_DB_FIRST_8_BIT, 8);
+    }
+    else
+    {
+        byte = hhg_lcd_read_bits(HHG_DB_FIRST_4_BIT, 4) << 4;    // upper
+        byte |= hhg_lcd_read_bits(HHG_DB_FIRST_4_BIT, 4);        // lower
+    }
+
+    return byte;
+}
+
+bool hhg_lcd_bus_ready(u8* addr)
+{
+    for(u8 i = 0; i < HHG_BUSY_POLL_MAX; i++)
+    {
+        //bit 7 is the busy flag, the address counter is valid once it is clear
+        u8 byte = hhg_lcd_bus_read(HHG_COMMAND_MODE);
+        if(!(byte & 0x80))
+        {
+            *addr = byte;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void hhg_lcd_verify_start(void)
+{
+    if(gpio_rw == -1 || verify_ms == 0)
+    {
+        return;
+    }
+
+    verify_enabled = true;
+    hhg_lcd_timer_arm(&verify_timer, verify_ms);
+}
+
+void hhg_lcd_verify(void)
+{
+    //the pins may already be suspended, resume arms the timer again
+    if(!verify_enabled || suspended)
+    {
+        return;
+    }
+
+    bool in_step = hhg_lcd_verify_interface();
+    if(!in_step)
+    {
+        //resync only the interface, the DDRAM content survives and is checked below
+        pr_warn("bus out of step, resync");
+        hhg_lcd_core_resync(&lcd_core);
+        hhg_lcd_core_command(&lcd_core, 0x06);		// Entry mode set
+        hhg_lcd_core_set_flags(&lcd_core, lcd_core.display_flags);
+
+        in_step = hhg_lcd_verify_interface();
+        if(!in_step)
+        {
+            pr_err("bus resync failed");
+        }
+    }
+
+    if(in_step)
+    {
+        char frame[HHG_CELLS_MAX];
+        u8 mismatches = 0;
+        u8 first = 0;
+        u8 last = HHG_CELLS_MAX - 1;
+        u8 addr;
+
+        hhg_lcd_core_frame(&lcd_core, frame);
+
+        //the address counter moves to the next cell after each read, one run in its order
+        //covers all the rows and hidden cells in between are read and ignored
+        while(lcd_core.ddram_cells[first] == HHG_CELL_NONE)
+        {
+            first++;
+        }
+        while(lcd_core.ddram_cells[last] == HHG_CELL_NONE)
+        {
+            last--;
+        }
+
+        hhg_lcd_core_set_addr(&lcd_core, hhg_lcd_ddram_addr(first));
+        hhg_lcd_bus_read_begin();
+        for(u8 index = first; index <= last; index++)
+        {
+            if(!hhg_lcd_bus_ready(&addr))
+            {
+                pr_err("panel busy, readback aborted");
+                break;
+            }
+
+            u8 byte = hhg_lcd_bus_read(HHG_DATA_MODE);
+            u8 cell = lcd_core.ddram_cells[index];
+            if(cell != HHG_CELL_NONE && byte != (u8)lcd_core.glass[cell])
+            {
+                //cell no more known, the flush writes it again
+                lcd_core.glass[cell] = HHG_CELL_KEEP;
+                mismatches++;
+            }
+        }
+        hhg_lcd_bus_read_end();
+        lcd_core.addr = HHG_ADDR_UNKNOWN;
+
+        if(mismatches > 0)
+        {
+            pr_warn("%u cells differ from the shadow, rewritten", mismatches);
+            hhg_lcd_core_flush(&lcd_core, frame);
+        }
+        hhg_lcd_core_show_cursor(&lcd_core);
+    }
+
+    hhg_lcd_timer_arm(&verify_timer, verify_ms);
+}
+
+bool hhg_lcd_verify_interface(void)
+{
+    //0x40, start of the second line, has different nibbles, a shifted stream cannot read it back
+    const u8 addr = 0x40;
+
+    u8 read_addr;
+
+    hhg_lcd_core_set_addr(&lcd_core, addr);
+
+    hhg_lcd_bus_read_begin();
+    bool ready = hhg_lcd_bus_ready(&read_addr);
+    hhg_lcd_bus_read_end();
+
+    return ready && read_addr == addr;
+}
+
+void hhg_lcd_verify_stop(void)
+{
+    if(!verify_enabled)
+    {
+        return;
+    }
+
+    del_timer_sync(&verify_timer);
+    verify_enabled = false;
+}
+
+int hhg_lcd_verify_cancel(void)
+{
+    return hhg_lcd_cmd_run(HHG_CMD_VERIFY_STOP);
+}
+
+//IDLE BLANKING
+
+void hhg_lcd_idle_timer_fn(struct timer_list* timer)
+{
+    hhg_lcd_cmd_timer_fn(HHG_CMD_IDLE, timer, 0);
+}
+
+void hhg_lcd_idle_start(void)
+{
+    if(idle_ms == 0)
+    {
+        return;
+    }
+
+    idle_enabled = true;
+    hhg_lcd_timer_arm(&idle_timer, idle_ms);
+}
+
+void hhg_lcd_idle_touch(enum hhg_lcd_cmd_type type)
+{
+    switch (type)
+    {
+    case HHG_CMD_ANIM_STOP:
+    case HHG_CMD_INIT:
+    case HHG_CMD_VERIFY:
+    case HHG_CMD_VERIFY_STOP:
+    case HHG_CMD_IDLE:
+    case HHG_CMD_IDLE_STOP:
+    case HHG_CMD_SUSPEND:
+    case HHG_CMD_RESUME:
+        return;
+    default:
+        break;
+    }
+
+    //asleep the display stays off, resume decides
+    if(suspended)
+    {
+        return;
+    }
+
+    //the write has already updated the cells in the dark, one instruction shows them
+    hhg_lcd_core_blank(&lcd_core, false);
+
+    if(idle_enabled)
+    {
+        hhg_lcd_timer_arm(&idle_timer, idle_ms);
+    }
+}
+
+void hhg_lcd_idle(void)
+{
+    //a write queued before this command has armed the timer again
+    if(!idle_enabled || timer_pending(&idle_timer))
+    {
+        return;
+    }
+
+    hhg_lcd_core_blank(&lcd_core, true);
+}
+
+void hhg_lcd_idle_stop(void)
+{
+    if(!idle_enabled)
+    {
+        return;
+    }
+
+    del_timer_sync(&idle_timer);
+    idle_enabled = false;
+}
+
+int hhg_lcd_idle_cancel(void)
+{
+    return hhg_lcd_cmd_run(HHG_CMD_IDLE_STOP);
+}
+
+void hhg_lcd_bus_suspend(void)
+{
+    //no timer work while sleeping, armed again on resume
+    suspended = true;
+    del_timer_sync(&anim_timer);
+    del_timer_sync(&verify_timer);
+    del_timer_sync(&idle_timer);
+
+    suspend_blanked = lcd_core.blanked;
+    hhg_lcd_core_blank(&lcd_core, true);
+}
+
+void hhg_lcd_bus_resume(void)
+{
+    //the panel may have lost power: interface and DDRAM are restored while the display is still off
+    hhg_lcd_core_warm(&lcd_core, true);
+
+    if(!suspend_blanked)
+    {
+        hhg_lcd_core_blank(&lcd_core, false);
+    }
+
+    suspended = false;
+    if(anim_player)
+    {
+        hhg_lcd_timer_arm(&anim_timer, 0);
+    }
+    if(verify_enabled)
+    {
+        hhg_lcd_timer_arm(&verify_timer, verify_ms);
+    }
+    if(idle_enabled)
+    {
+        hhg_lcd_timer_arm(&idle_timer, idle_ms);
+    }
+}
+
+int hhg_lcd_pm_suspend(struct device *dev)
+{
+    return hhg_lcd_cmd_run(HHG_CMD_SUSPEND);
+}
+
+int hhg_lcd_pm_resume(struct device *dev)
+{
+    return hhg_lcd_cmd_run(HHG_CMD_RESUME);
+}
+
+void hhg_lcd_send_command(u8 command)
+{
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_COMMAND, command, 0, GFP_KERNEL);
+    if(cmd)
+    {
+        hhg_lcd_cmd_submit(cmd);
+    }
+}
+EXPORT_SYMBOL(hhg_lcd_send_command);
+
+void hhg_lcd_send_char(char byte)
+{
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_CHAR, byte, 0, GFP_KERNEL);
+    if(cmd)
+    {
+        hhg_lcd_cmd_submit(cmd);
+    }
+}
+EXPORT_SYMBOL(hhg_lcd_send_char);
+
+void hhg_lcd_send_str(const char buff[])
+{
+    if(!buff)
+    {
+        return;
+    }
+
+    size_t len = strlen(buff);
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_STR, 0, len + 1, GFP_KERNEL);
+    if(cmd)
+    {
+        memcpy(cmd->str, buff, len + 1);
+        hhg_lcd_cmd_submit(cmd);
+    }
+}
+EXPORT_SYMBOL(hhg_lcd_send_str);
+
+void hhg_lcd_clear(void)
+{
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_CLEAR, 0, 0, GFP_KERNEL);
+    if(cmd)
+    {
+        hhg_lcd_cmd_submit(cmd);
+    }
+}
+EXPORT_SYMBOL(hhg_lcd_clear);
+
+void hhg_lcd_select_row(enum hhg_row row)
+{
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_SELECT_ROW, row, 0, GFP_KERNEL);
+    if(cmd)
+    {
+        hhg_lcd_cmd_submit(cmd);
+    }
+}
+EXPORT_SYMBOL(hhg_lcd_select_row);
+
+void hhg_lcd_set_flags(u8 flags)
+{
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_SET_FLAGS, flags, 0, GFP_KERNEL);
+    if(cmd)
+    {
+        hhg_lcd_cmd_submit(cmd);
+    }
+}
+EXPORT_SYMBOL(hhg_lcd_set_flags);
+
+int hhg_lcd_submit(const char frame[], u32 flags, hhg_lcd_callback callback, void* ctx)
+{
+    if(!frame)
+    {
+        return -EINVAL;
+    }
+
+    size_t len = strnlen(frame, HHG_FRAME_MAX_LEN);
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_STR, 0, len + 1, GFP_ATOMIC);
+    if(!cmd)
+    {
+        return -ENOMEM;
+    }
+
+    memcpy(cmd->str, frame, len);
+    cmd->str[len] = '\0';
+    cmd->flags = flags;
+    cmd->callback = callback;
+    cmd->ctx = ctx;
+
+    hhg_lcd_cmd_queue(cmd);
+
+    return 0;
+}
+EXPORT_SYMBOL(hhg_lcd_submit);
+
+//MODULE
+
+
+
+// data
+static dev_t hhg_dev = 0;  ///< Device number for the HHG device.
+static struct class* hhg_class;  ///< Pointer to the device class for the HHG device.
+static struct cdev hhg_cdev;  ///< Character device structure for the HHG device.
+static atomic_t device_busy = ATOMIC_INIT(0);  ///< Atomic variable to track device availability.
+
+/**
+ * @brief Uevent callback function for HHG LCD device.
+ *
+ * This function is called when a uevent (user event) occurs for the HHG LCD device.
+ * It handles changing the access permissions in user space.
+ *
+ * @param dev Pointer to the device structure.
+ * @param env Pointer to the kobj_uevent_env structure containing the uevent environment.
+ * @return The return value indicates the success or failure of the uevent handling.
+ */
+static int hhg_lcd_uevent(struct device* dev, struct kobj_uevent_env* env);
+
+/**
+ * @brief File operations open function for HHG LCD device.
+ *
+ * This function is called when the HHG LCD device file is opened.
+ *
+ * @param inode Pointer to the inode structure.
+ * @param file Pointer to the file structure.
+ * @return The return value indicates the success or failure of the file open operation.
+ */
+static int hhg_lcd_fops_open(struct inode* inode, struct file* file);
+
+/**
+ * @brief File operations release function for HHG LCD device.
+ *
+ * This function is called when the HHG LCD device file is closed.
+ *
+ * @param inode Pointer to the inode structure.
+ * @param file Pointer to the file structure.
+ * @return The return value indicates the success or failure of the file release operation.
+ */
+static int hhg_lcd_fops_release(struct inode* inode, struct file* file);
+
+/**
+ * @brief File operations read function for HHG LCD device.
+ *
+ * This function is called when a read operation is performed on the HHG LCD device file.
+ *
+ * @param filp Pointer to the file structure.
+ * @param buff User buffer to store the read data.
+ * @param len Number of bytes to read.
+ * @param off Pointer to the file offset.
+ * @return The number of bytes read, or an error code indicating the failure of the read operation.
+ */
+static ssize_t hhg_lcd_fops_read(struct file* filp, char __user* buff, size_t len, loff_t* off);
+
+/**
+ * @brief File operations write_iter function for HHG LCD device.
+ *
+ * This function is called when a write operation is performed on the HHG LCD device file.
+ * A single segment is a text stream for the escape sequence parser, see hhg_lcd_fops_write_stream().
+ * Several segments, as from writev(), are placed one per row, see hhg_lcd_fops_write_rows().
+ *
+ * @param iocb Pointer to the I/O control block.
+ * @param from Iterator over the user segments.
+ * @return The number of bytes written, or an error code indicating the failure of the write operation.
+ */
+static ssize_t hhg_lcd_fops_write_iter(struct kiocb* iocb, struct iov_iter* from);
+
+/**
+ * @brief Writes a text stream through the escape sequence parser.
+ *
+ * @param filp Pointer to the file structure.
+ * @param from Iterator over the user data.
+ * @return The number of bytes written, or an error code.
+ */
+static ssize_t hhg_lcd_fops_write_stream(struct file* filp, struct iov_iter* from);
+
+/**
+ * @brief Places each segment at the start of its row.
+ *
+ * Segment N is copied as literal text into row N of the frame up to its first control
+ * character, the rest of the row is blanked. An empty segment, or one starting with a
+ * control character, leaves its row untouched, segments past the last row are ignored.
+ *
+ * @param from Iterator over the user segments.
+ * @return The number of bytes written, or an error code.
+ */
+static ssize_t hhg_lcd_fops_write_rows(struct iov_iter* from);
+
+/**
+ * @brief File operations ioctl function for HHG LCD device.
+ *
+ * This function is called when an ioctl is performed on the HHG LCD device file, see hhg_lcd_ioctl.h.
+ *
+ * @param filp Pointer to the file structure.
+ * @param cmd The ioctl command.
+ * @param arg The ioctl argument.
+ * @return 0 on success, or an error code indicating the failure of the ioctl.
+ */
+static long hhg_lcd_fops_ioctl(struct file* filp, unsigned int cmd, unsigned long arg);
+
+/**
+ * @brief Uploads an animation and starts to play it.
+ *
+ * @param arg User pointer to the animation descriptor.
+ * @return 0 on success, or an error code.
+ */
+static long hhg_lcd_ioctl_anim_play(const struct hhg_lcd_anim __user* arg);
+
+
+/**
+ * @brief Shows the SCHED_FIFO priority of the bus owner.
+ */
+static ssize_t bus_priority_show(struct device* dev, struct device_attribute* attr, char* buf);
+
+/**
+ * @brief Sets the SCHED_FIFO priority of the bus owner, 0 for SCHED_NORMAL.
+ */
+static ssize_t bus_priority_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count);
+
+/**
+ * @brief Shows the CPUs the bus owner can run on.
+ */
+static ssize_t bus_cpus_show(struct device* dev, struct device_attribute* attr, char* buf);
+
+/**
+ * @brief Sets the CPUs the bus owner can run on, as cpulist.
+ */
+static ssize_t bus_cpus_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count);
+
+/**
+ * @brief Shows the number of EN pulses since load, each one is two edges.
+ */
+static ssize_t bus_transfers_show(struct device* dev, struct device_attribute* attr, char* buf);
+
+// Region of the glass exposed as a sysfs attribute
+struct hhg_lcd_field
+{
+    struct device_attribute attr;  ///< The sysfs attribute, named after the field.
+    u8 row;  ///< Row, 0-based.
+    u8 col;  ///< First column, 0-based.
+    u8 width;  ///< Number of cells.
+};
+
+static char* fields = NULL;  ///< Fields from the module parameter, as name:row:col:width comma separated.
+static char* fields_buf = NULL;  ///< Copy of the parameter holding the field names.
+static struct hhg_lcd_field fields_table[HHG_FIELDS_MAX];  ///< Configured fields.
+static struct attribute* fields_attrs[HHG_FIELDS_MAX + 1];  ///< Attributes of the configured fields, NULL terminated.
+
+/**
+ * @brief Shows the cells of a row or field.
+ */
+static ssize_t hhg_lcd_field_show(struct device* dev, struct device_attribute* attr, char* buf);
+
+/**
+ * @brief Writes the cells of a row or field, the rest of the glass is left untouched.
+ *
+ * Text longer than the region is truncated, shorter is blank padded. The update is queued,
+ * the write does not wait for the bus and does not need the device open.
+ */
+static ssize_t hhg_lcd_field_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count);
+
+/**
+ * @brief Parses the fields module parameter into the fields attribute group.
+ *
+ * @return 0 on success, -EINVAL on a malformed field, -ENOMEM on failure.
+ */
+static int hhg_lcd_fields_parse(void);
+
+/**
+ * @brief Frees the field names.
+ */
+static void hhg_lcd_fields_free(void);
+
+/**
+ * @brief Hides the row attributes past the last row of the glass.
+ */
+static umode_t hhg_lcd_attr_visible(struct kobject* kobj, struct attribute* attr, int n);
+
+// width set at load from the geometry
+#define HHG_FIELD_ROW(_name, _row) \
+    struct hhg_lcd_field field_##_name = { \
+        .attr = __ATTR(_name, 0644, hhg_lcd_field_show, hhg_lcd_field_store), \
+        .row = _row, \
+        .col = 0, \
+        .width = 0, \
+    }
+
+static DEVICE_ATTR_RW(bus_priority);
+static DEVICE_ATTR_RW(bus_cpus);
+static DEVICE_ATTR_RO(bus_transfers);
+static HHG_FIELD_ROW(row1, 0);
+static HHG_FIELD_ROW(row2, 1);
+static HHG_FIELD_ROW(row3, 2);
+static HHG_FIELD_ROW(row4, 3);
+
+static struct hhg_lcd_field* const field_rows[HHG_ROWS_MAX] = { &field_row1, &field_row2, &field_row3, &field_row4 };
+
+static struct attribute* hhg_lcd_attrs[] = {
+    &dev_attr_bus_priority.attr,
+    &dev_attr_bus_cpus.attr,
+    &dev_attr_bus_transfers.attr,
+    &field_row1.attr.attr,
+    &field_row2.attr.attr,
+    &field_row3.attr.attr,
+    &field_row4.attr.attr,
+    NULL
+};
+
+static const struct attribute_group hhg_lcd_group = {
+    .attrs = hhg_lcd_attrs,
+    .is_visible = hhg_lcd_attr_visible,
+};
+
+static const struct attribute_group hhg_lcd_fields_group = {
+    .name = "fields",
+    .attrs = fields_attrs,
+};
+
+static const struct attribute_group* hhg_lcd_groups[] = {
+    &hhg_lcd_group,
+    NULL,  //hhg_lcd_fields_group when fields are configured
+    NULL
+};
+
+module_param(gpio_rs, short, 0660);
+MODULE_PARM_DESC(gpio_rs, "GPIO RS - Select registers");
+
+module_param(gpio_en, short, 0660);
+MODULE_PARM_DESC(gpio_en, "GPIO EN - Start data read/write");
+
+module_param(gpio_rw, short, 0660);
+MODULE_PARM_DESC(gpio_rw, "GPIO RW - Read/write select, optional, tie R/W to ground when not wired. With R/W high a 5 V panel drives 5 V on the data GPIOs: 3.3 V panel or level shifters only");
+
+module_param(gpio_db0, short, 0660);
+MODULE_PARM_DESC(gpio_db0, "GPIO DB0 - bit 0");
+
+module_param(gpio_db1, short, 0660);
+MODULE_PARM_DESC(gpio_db1, "GPIO DB1 - bit 1");
+
+module_param(gpio_db2, short, 0660);
+MODULE_PARM_DESC(gpio_db2, "GPIO DB2 - bit 2");
+
+module_param(gpio_db3, short, 0660);
+MODULE_PARM_DESC(gpio_db3, "GPIO DB3 - bit 3");
+
+module_param(gpio_db4, short, 0660);
+MODULE_PARM_DESC(gpio_db4, "GPIO DB4 - bit 4");
+
+module_param(gpio_db5, short, 0660);
+MODULE_PARM_DESC(gpio_db5, "GPIO DB5 - bit 5");
+
+module_param(gpio_db6, short, 0660);
+MODULE_PARM_DESC(gpio_db6, "GPIO DB6 - bit 6");
+
+module_param(gpio_db7, short, 0660);
+MODULE_PARM_DESC(gpio_db7, "GPIO DB7 - bit 7");
+
+module_param(rows, byte, 0444);
+MODULE_PARM_DESC(rows, "Rows of the glass, 1 to 4 - default 2");
+
+module_param(cols, byte, 0444);
+MODULE_PARM_DESC(cols, "Columns of the glass, rows * cols at most 80 - default 16");
+
+module_param_array(row_offsets, byte, &row_offsets_count, 0444);
+MODULE_PARM_DESC(row_offsets, "DDRAM address of the first cell of each row, one per row - default 0x00,0x40,cols,0x40+cols");
+
+module_param(warm_start, bool, 0444);
+MODULE_PARM_DESC(warm_start, "Skip the power-on reset sequence, the panel is already initialized, e.g. after rmmod/insmod - default false");
+
+module_param(verify_ms, uint, 0444);
+MODULE_PARM_DESC(verify_ms, "Period in ms of the DDRAM readback check, needs gpio_rw, 0 to disable - default 0");
+
+module_param(idle_ms, uint, 0444);
+MODULE_PARM_DESC(idle_ms, "Time in ms without writes before the display is switched off keeping its content, 0 to disable - default 0");
+
+module_param(fields, charp, 0444);
+MODULE_PARM_DESC(fields, "Fields exposed in sysfs as name:row:col:width comma separated, row and col 1-based - default none");
+
+module_param(bus_priority, uint, 0444);
+MODULE_PARM_DESC(bus_priority, "SCHED_FIFO priority of the bus thread, 0 for SCHED_NORMAL - default 1");
+
+module_param(bus_cpus, charp, 0444);
+MODULE_PARM_DESC(bus_cpus, "CPUs the bus thread can run on as cpulist - default all");
+
+
+// File operation structure
+static struct file_operations fops = {
+    .owner = THIS_MODULE,
+    .read = hhg_lcd_fops_read,
+    .write_iter = hhg_lcd_fops_write_iter,
+    .unlocked_ioctl = hhg_lcd_fops_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .open = hhg_lcd_fops_open,
+    .release = hhg_lcd_fops_release
+};
+
+
+/*
+* Module Init function
+*/
+static int __init hhg_lcd_module_init(void)
+{
+    if ((row_offsets_count > 0 && row_offsets_count != rows)
+        || !hhg_lcd_geometry_init(&lcd_geometry, rows, cols, row_offsets_count > 0 ? row_offsets : NULL))
+    {
+        pr_err("wrong geometry rows:%u cols:%u\n", rows, cols);
+        return -EINVAL;
+    }
+    for (u8 row = 0; row < HHG_ROWS_MAX; row++)
+    {
+        field_rows[row]->width = cols;
+    }
+
+    if (hhg_lcd_fields_parse() != 0)
+    {
+        pr_err("cannot parse fields\n");
+        return -EINVAL;
+    }
+
+    /*Creating bus owner*/
+    if (IS_ERR(bus_thread = kthread_run(hhg_lcd_bus_thread_fn, NULL, HHG_DRIVER_NAME)))
+    {
+        pr_err("cannot create the bus thread\n");
+        goto r_fields;
+    }
+
+    if (hhg_lcd_bus_set_priority(bus_priority) != 0)
+    {
+        pr_warn("cannot set bus thread priority:%u\n", bus_priority);
+    }
+
+    if (bus_cpus && hhg_lcd_bus_set_cpus(bus_cpus) != 0)
+    {
+        pr_warn("cannot set bus thread cpus:%s\n", bus_cpus);
+    }
+
+    //pins and core are ready and the panel init is queued before any writer can reach the bus
+    if(!hhg_lcd_init())
+    {
+        pr_err("cannot init LCD\n");
+        goto r_thread;
+    }
+
+    /*Allocating Major number*/
+    if ((alloc_chrdev_region(&hhg_dev, HHG_MAJOR_NUM_START, HHG_MINOR_NUM_COUNT, HHG_DRIVER_NAME)) < 0)
+    {
+        pr_err("cannot allocate major number\n");
+        goto r_lcd;
+    }
+    pr_info("Major = %d Minor = %d \n", MAJOR(hhg_dev), MINOR(hhg_dev));
+
+    /*Creating cdev structure*/
+    cdev_init(&hhg_cdev, &fops);
+
+    /*Adding character device to the system*/
+    if ((cdev_add(&hhg_cdev, hhg_dev, 1)) < 0)
+    {
+        pr_err("cannot add the device to the system\n");
+        goto r_unreg;
+    }
+
+    /*Creating struct class*/
+    if ((hhg_class = class_create(THIS_MODULE, HHG_CLASS_NAME)) == NULL)
+    {
+        pr_err("cannot create the struct class\n");
+        goto r_dev;
+    }
+    hhg_class->dev_uevent = hhg_lcd_uevent;
+    hhg_class->pm = &hhg_lcd_pm_ops;
+
+    /*Creating device*/
+    if (IS_ERR(device_create_with_groups(hhg_class, NULL, hhg_dev, NULL, hhg_lcd_groups, HHG_DRIVER_NAME)))
+    {
+        pr_err("cannot create the Device \n");
+        goto r_class;
+    }
+
+    return 0;
+
+r_class:
+    class_destroy(hhg_class);
+r_dev:
+    cdev_del(&hhg_cdev);
+r_unreg:
+    unregister_chrdev_region(hhg_dev, 1);
+r_lcd:
+    //the queued init may already have armed the readback and idle timers
+    hhg_lcd_verify_cancel();
+    hhg_lcd_idle_cancel();
+    kthread_stop(bus_thread);
+    hhg_lcd_free();
+    hhg_lcd_fields_free();
+    return -ENXIO;
+r_thread:
+    kthread_stop(bus_thread);
+r_fields:
+    hhg_lcd_fields_free();
+    return -ENXIO;
+}
+module_init(hhg_lcd_module_init);
+
+/*
+* Module exit function
+*/
+static void __exit hhg_lcd_module_exit(void)
+{
+    //no more sysfs users of the bus thread
+    device_destroy(hhg_class, hhg_dev);
+
+    hhg_lcd_anim_cancel();
+    hhg_lcd_verify_cancel();
+    hhg_lcd_idle_cancel();
+
+    //drain pending commands before to take back the bus
+    kthread_stop(bus_thread);
+
+    //blank and configured, the known state warm_start relies on
+    hhg_lcd_core_clear(&lcd_core);
+    hhg_lcd_core_set_flags(&lcd_core, HHG_LCD_DISPLAY_OFF);
+
+    hhg_lcd_free();
+    class_destroy(hhg_class);
+    cdev_del(&hhg_cdev);
+    unregister_chrdev_region(hhg_dev, 1);
+    hhg_lcd_fields_free();
+    pr_info("exit");
+}
+module_exit(hhg_lcd_module_exit);
+
+int hhg_lcd_fops_open(struct inode *inode, struct file *file)
+{
+    if (atomic_read(&device_busy) > 0)
+    {
+        pr_err("device busy");
+        return -EBUSY;
+    }
+
+    struct hhg_lcd_esc* esc = kmalloc(sizeof(*esc), GFP_KERNEL);
+    if(!esc)
+    {
+        return -ENOMEM;
+    }
+    hhg_lcd_esc_reset(esc);
+    file->private_data = esc;
+
+    atomic_inc(&device_busy);
+
+    pr_info("open:%u\n", atomic_read(&device_busy));
+    return 0;
+}
+
+int hhg_lcd_fops_release(struct inode *inode, struct file *file)
+{
+    kfree(file->private_data);
+    atomic_sub(1, &device_busy);
+
+    pr_info("release:%u\n", atomic_read(&device_busy));
+    return 0;
+}
+
+ssize_t hhg_lcd_fops_read(struct file *filp, char __user *buff, size_t len, loff_t *off)
+{
+    char screen[HHG_FRAME_MAX_LEN];
+    char frame[HHG_CELLS_MAX];
+    size_t screen_len = 0;
+
+    hhg_lcd_core_frame(&lcd_core, frame);
+    for(u8 row = 0; row < lcd_geometry.rows; row++)
+    {
+        memcpy(&screen[screen_len], &frame[row * lcd_geometry.cols], lcd_geometry.cols);
+        screen_len += lcd_geometry.cols;
+        screen[screen_len++] = '\n';
+    }
+
+    return simple_read_from_buffer(buff, len, off, screen, screen_len);
+}
+
+ssize_t hhg_lcd_fops_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    if(iter_is_iovec(from) && from->nr_segs > 1)
+    {
+        return hhg_lcd_fops_write_rows(from);
+    }
+
+    return hhg_lcd_fops_write_stream(iocb->ki_filp, from);
+}
+
+ssize_t hhg_lcd_fops_write_stream(struct file *filp, struct iov_iter *from)
+{
+    size_t bytes_to_write = min_t(size_t, iov_iter_count(from), HHG_STREAM_MAX_LEN);
+
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_STREAM, 0, bytes_to_write, GFP_KERNEL);
+    if(!cmd)
+    {
+        return -ENOMEM;
+    }
+
+    if(copy_from_iter(cmd->str, bytes_to_write, from) != bytes_to_write)
+    {
+        kfree(cmd);
+        return -EFAULT;
+    }
+    cmd->esc = filp->private_data;
+
+    hhg_lcd_cmd_submit(cmd);
+
+    return bytes_to_write;
+}
+
+ssize_t hhg_lcd_fops_write_rows(struct iov_iter *from)
+{
+    size_t bytes_to_write = iov_iter_count(from);
+    unsigned long nr_segs = from->nr_segs;
+    const struct iovec* iov = from->iov;
+
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_FRAME, 0, lcd_geometry.rows * lcd_geometry.cols, GFP_KERNEL);
+    if(!cmd)
+    {
+        return -ENOMEM;
+    }
+    memset(cmd->str, HHG_CELL_KEEP, lcd_geometry.rows * lcd_geometry.cols);
+
+    for(unsigned long seg = 0; seg < nr_segs && seg < lcd_geometry.rows; seg++)
+    {
+        size_t seg_len = iov[seg].iov_len;
+        if(seg_len == 0)
+        {
+            continue;
+        }
+
+        char* row = &cmd->str[seg * lcd_geometry.cols];
+        size_t to_copy = min_t(size_t, seg_len, lcd_geometry.cols);
+
+        if(copy_from_iter(row, to_copy, from) != to_copy)
+        {
+            kfree(cmd);
+            return -EFAULT;
+        }
+
+        //no parser here, a control char would show as a CGRAM glyph: the text ends there
+        size_t text_len = 0;
+        while(text_len < to_copy && (u8)row[text_len] >= 0x20)
+        {
+            text_len++;
+        }
+
+        if(text_len == 0)
+        {
+            memset(row, HHG_CELL_KEEP, lcd_geometry.cols);
+        }
+        else
+        {
+            memset(row + text_len, ' ', lcd_geometry.cols - text_len);
+        }
+
+        //skip what does not fit in the row
+        iov_iter_advance(from, seg_len - to_copy);
+    }
+
+    hhg_lcd_cmd_submit(cmd);
+
+    return bytes_to_write;
+}
+
+long hhg_lcd_fops_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    switch (cmd)
+    {
+    case HHG_LCD_IOC_ANIM_PLAY:
+        return hhg_lcd_ioctl_anim_play((const struct hhg_lcd_anim __user*)arg);
+    case HHG_LCD_IOC_ANIM_STOP:
+        return hhg_lcd_anim_cancel();
+    default:
+        return -ENOTTY;
+    }
+}
+
+long hhg_lcd_ioctl_anim_play(const struct hhg_lcd_anim __user *arg)
+{
+    struct hhg_lcd_anim req;
+    long ret = 0;
+
+    if(copy_from_user(&req, arg, sizeof(req)))
+    {
+        return -EFAULT;
+    }
+
+    if(req.frames_count == 0
+        || req.frames_count > HHG_LCD_ANIM_MAX_FRAMES
+        || req.cells_per_frame != lcd_geometry.rows * lcd_geometry.cols
+        || req.reserved != 0
+        || (req.flags & ~(HHG_LCD_ANIM_LOOP | HHG_LCD_ANIM_OVERLAY)))
+    {
+        return -EINVAL;
+    }
+
+    struct hhg_lcd_anim_player* anim = kzalloc(sizeof(*anim), GFP_KERNEL);
+    if(!anim)
+    {
+        return -ENOMEM;
+    }
+    anim->frames_count = req.frames_count;
+    anim->flags = req.flags;
+
+    u32* durations = memdup_user(u64_to_user_ptr(req.durations), req.frames_count * sizeof(u32));
+    if(IS_ERR(durations))
+    {
+        ret = PTR_ERR(durations);
+        goto r_free;
+    }
+    anim->durations = durations;
+
+    char* cells = vmemdup_user(u64_to_user_ptr(req.cells), (size_t)req.frames_count * req.cells_per_frame);
+    if(IS_ERR(cells))
+    {
+        ret = PTR_ERR(cells);
+        goto r_free;
+    }
+    anim->cells = cells;
+
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_ANIM_START, 0, 0, GFP_KERNEL);
+    if(!cmd)
+    {
+        ret = -ENOMEM;
+        goto r_free;
+    }
+    cmd->anim = anim;
+
+    hhg_lcd_cmd_submit(cmd);
+
+    return 0;
+
+r_free:
+    hhg_lcd_anim_free(anim);
+    return ret;
+}
+
+ssize_t bus_priority_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", bus_priority);
+}
+
+ssize_t bus_priority_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    unsigned int priority;
+
+    int ret = kstrtouint(buf, 0, &priority);
+    if(ret)
+    {
+        return ret;
+    }
+
+    ret = hhg_lcd_bus_set_priority(priority);
+    if(ret)
+    {
+        return ret;
+    }
+
+    return count;
+}
+
+ssize_t bus_cpus_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%*pbl\n", cpumask_pr_args(bus_thread->cpus_ptr));
+}
+
+ssize_t bus_cpus_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int ret = hhg_lcd_bus_set_cpus(buf);
+    if(ret)
+    {
+        return ret;
+    }
+
+    return count;
+}
+
+ssize_t bus_transfers_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", READ_ONCE(bus_transfers));
+}
+
+ssize_t hhg_lcd_field_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    const struct hhg_lcd_field* field = container_of(attr, struct hhg_lcd_field, attr);
+    char frame[HHG_CELLS_MAX];
+
+    hhg_lcd_core_frame(&lcd_core, frame);
+
+    return sysfs_emit(buf, "%.*s\n", field->width, &frame[field->row * lcd_geometry.cols + field->col]);
+}
+
+ssize_t hhg_lcd_field_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    const struct hhg_lcd_field* field = container_of(attr, struct hhg_lcd_field, attr);
+
+    size_t len = count;
+    if(len > 0 && buf[len - 1] == '\n')
+    {
+        len--;
+    }
+    len = min_t(size_t, len, field->width);
+
+    struct hhg_lcd_cmd* cmd = hhg_lcd_cmd_alloc(HHG_CMD_FRAME, 0, lcd_geometry.rows * lcd_geometry.cols, GFP_KERNEL);
+    if(!cmd)
+    {
+        return -ENOMEM;
+    }
+
+    //only the cells of the region differing from the shadow reach the bus
+    memset(cmd->str, HHG_CELL_KEEP, lcd_geometry.rows * lcd_geometry.cols);
+    char* cells = &cmd->str[field->row * lcd_geometry.cols + field->col];
+    memcpy(cells, buf, len);
+    memset(cells + len, ' ', field->width - len);
+
+    hhg_lcd_cmd_queue(cmd);
+
+    return count;
+}
+
+int hhg_lcd_fields_parse(void)
+{
+    if(!fields || !*fields)
+    {
+        return 0;
+    }
+
+    fields_buf = kstrdup(fields, GFP_KERNEL);
+    if(!fields_buf)
+    {
+        return -ENOMEM;
+    }
+
+    char* cur = fields_buf;
+    char* token;
+    u8 count = 0;
+    while((token = strsep(&cur, ",")) != NULL)
+    {
+        char* name = strsep(&token, ":");
+        unsigned int row, col, width;
+
+        if(count == HHG_FIELDS_MAX)
+        {
+            pr_err("too many fields, max:%u", HHG_FIELDS_MAX);
+            goto r_free;
+        }
+
+        if(!*name
+            || !token
+            || sscanf(token, "%u:%u:%u", &row, &col, &width) != 3
+            || row < 1 || row > lcd_geometry.rows
+            || col < 1 || col > lcd_geometry.cols
+            || width < 1 || col - 1 + width > lcd_geometry.cols)
+        {
+            pr_err("wrong field:%s", name);
+            goto r_free;
+        }
+
+        //the name is a file of the fields directory
+        if(strchr(name, '/') || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        {
+            pr_err("wrong field name:%s", name);
+            goto r_free;
+        }
+
+        for(u8 i = 0; i < count; i++)
+        {
+            if(strcmp(fields_table[i].attr.attr.name, name) == 0)
+            {
+                pr_err("duplicate field:%s", name);
+                goto r_free;
+            }
+        }
+
+        struct hhg_lcd_field* field = &fields_table[count];
+        sysfs_attr_init(&field->attr.attr);
+        field->attr.attr.name = name;
+        field->attr.attr.mode = 0644;
+        field->attr.show = hhg_lcd_field_show;
+        field->attr.store = hhg_lcd_field_store;
+        field->row = row - 1;
+        field->col = col - 1;
+        field->width = width;
+
+        fields_attrs[count++] = &field->attr.attr;
+    }
+    fields_attrs[count] = NULL;
+
+    hhg_lcd_groups[1] = &hhg_lcd_fields_group;
+
+    return 0;
+
+r_free:
+    hhg_lcd_fields_free();
+    return -EINVAL;
+}
+
+void hhg_lcd_fields_free(void)
+{
+    kfree(fields_buf);
+    fields_buf = NULL;
+}
+
+umode_t hhg_lcd_attr_visible(struct kobject *kobj, struct attribute *attr, int n)
+{
+    for(u8 row = lcd_geometry.rows; row < HHG_ROWS_MAX; row++)
+    {
+        if(attr == &field_rows[row]->attr.attr)
+        {
+            return 0;
+        }
+    }
+
+    return attr->mode;
+}
+
+int hhg_lcd_uevent(struct device *dev, struct kobj_uevent_env *env)
+{
+    add_uevent_var(env, "DEVMODE=%#o", 0666);
+    return 0;
+}
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Antonio Salsi <passy.linux@zresa.it>");
+MODULE_DESCRIPTION("Driver for LCD 16x2, 20x4 and alike management with chip HITACHI HD44780U compatible.");
+MODULE_INFO(intree, "Y");
+MODULE_VERSION("0.90.1");
\ No newline at end of file
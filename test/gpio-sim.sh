@@ -0,0 +1,25 @@
+#!/bin/sh
+# Creates a simulated GPIO chip to run the userspace backend without a panel.
+# The values driven on the lines can be read from /sys/devices/platform/<dev_name>/<chip_name>/sim_gpio<N>/value
+# usage: gpio-sim.sh up|down
+
+SIM=/sys/kernel/config/gpio-sim/hhg_lcd
+LINES=16
+
+case "$1" in
+up)
+    modprobe gpio-sim || exit 1
+    mkdir -p "$SIM/bank0" || exit 1
+    echo $LINES > "$SIM/bank0/num_lines"
+    echo 1 > "$SIM/live"
+    echo "/dev/$(cat "$SIM/bank0/chip_name")"
+    ;;
+down)
+    echo 0 > "$SIM/live"
+    rmdir "$SIM/bank0" "$SIM"
+    ;;
+*)
+    echo "usage: $0 up|down"
+    exit 1
+    ;;
+esac
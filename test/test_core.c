@@ -0,0 +1,215 @@
+#include "hhg_lcd_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//cd gpiod && make check
+//no panel and no GPIO: the bus words of the core are decoded by a simulated HD44780,
+//its DDRAM is checked against the text written, not against the shadow framebuffer of the core
+//exits 1 on the first mismatch
+
+#define SIM_DDRAM_LEN   (0x68)
+#define SIM_FRAMES      (500)
+
+// Simulated panel, fed by hhg_lcd_core_ops.replay
+struct sim_panel
+{
+    u8 ddram[SIM_DDRAM_LEN];  ///< Display data RAM, 2-line addressing.
+    u8 ac;  ///< Address counter.
+    unsigned int set_addr;  ///< Set DDRAM address instructions received.
+};
+
+static struct sim_panel sim;
+
+static void sim_replay(void* ctx, const u16 words[], u16 count);
+static void sim_delay(void* ctx, unsigned int min_us, unsigned int max_us);
+
+static const struct hhg_lcd_core_ops sim_ops = {
+    .replay = sim_replay,
+    .delay = sim_delay,
+};
+
+void sim_replay(void* ctx, const u16 words[], u16 count)
+{
+    for(u16 i = 0; i < count; i++)
+    {
+        const u8 byte = words[i] & 0xFF;
+
+        if(words[i] & HHG_WORD_NIBBLE)
+        {
+            //function set halves of the reset, the interface is modeled per byte
+            continue;
+        }
+
+        if(words[i] & HHG_WORD_RS)
+        {
+            sim.ddram[sim.ac] = byte;
+            //2-line mode: the end of the first line jumps to the second one and back
+            sim.ac = sim.ac == 0x27 ? 0x40 : sim.ac == 0x67 ? 0x00 : sim.ac + 1;
+        }
+        else if(byte & 0x80)
+        {
+            sim.ac = byte & 0x7F;
+            sim.set_addr++;
+        }
+        else if(byte == 0x01)
+        {
+            memset(sim.ddram, ' ', sizeof(sim.ddram));
+            sim.ac = 0x00;
+        }
+        else if((byte & 0xFE) == 0x02)
+        {
+            sim.ac = 0x00;
+        }
+    }
+}
+
+void sim_delay(void* ctx, unsigned int min_us, unsigned int max_us)
+{
+}
+
+// Checks the simulated DDRAM against the expected screen, rows * cols cells row after row
+static int sim_check(const struct hhg_lcd_core* core, const char expected[], const char* what)
+{
+    const struct hhg_lcd_geometry* geometry = &core->geometry;
+
+    for(u8 row = 0; row < geometry->rows; row++)
+    {
+        for(u8 col = 0; col < geometry->cols; col++)
+        {
+            u8 got = sim.ddram[geometry->row_offsets[row] + col];
+            u8 want = expected[row * geometry->cols + col];
+            if(got != want)
+            {
+                fprintf(stderr, "%ux%u %s: row %u col %u is '%c', expected '%c'\n",
+                    geometry->cols, geometry->rows, what, row + 1, col + 1, got, want);
+                return 1;
+            }
+        }
+    }
+
+    //the core must know where the counter really is
+    if(core->addr != HHG_ADDR_UNKNOWN && core->addr != sim.ac)
+    {
+        fprintf(stderr, "%ux%u %s: address counter 0x%02x, the core expects 0x%02x\n",
+            geometry->cols, geometry->rows, what, sim.ac, core->addr);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int test_geometry(u8 rows, u8 cols)
+{
+    struct hhg_lcd_geometry geometry;
+    struct hhg_lcd_core core;
+    struct hhg_lcd_esc esc;
+    char expected[HHG_CELLS_MAX];
+    char frame[HHG_CELLS_MAX];
+    const u8 cells = rows * cols;
+
+    if(!hhg_lcd_geometry_init(&geometry, rows, cols, NULL))
+    {
+        fprintf(stderr, "%ux%u: geometry refused\n", cols, rows);
+        return 1;
+    }
+
+    memset(&sim, 0, sizeof(sim));
+    hhg_lcd_core_setup(&core, &sim_ops, NULL, false, &geometry);
+    hhg_lcd_core_power_on(&core);
+    memset(expected, ' ', cells);
+    if(sim_check(&core, expected, "power on"))
+    {
+        return 1;
+    }
+
+    //full screen of text, wrapping from row to row
+    hhg_lcd_esc_reset(&esc);
+    for(u8 i = 0; i < cells; i++)
+    {
+        frame[i] = 'A' + i % 26;
+    }
+    hhg_lcd_core_stream(&core, &esc, frame, cells, false);
+    memcpy(expected, frame, cells);
+    if(sim_check(&core, expected, "full screen"))
+    {
+        return 1;
+    }
+
+    //escape sequences on the same stream: cursor position, text, clear to end of line
+    char seq[32];
+    int len = snprintf(seq, sizeof(seq), "\033[%u;3Hxy\033[1;%uH\033[K", rows, cols - 1);
+    hhg_lcd_core_stream(&core, &esc, seq, len, false);
+    expected[(rows - 1) * cols + 2] = 'x';
+    expected[(rows - 1) * cols + 3] = 'y';
+    expected[cols - 2] = ' ';
+    expected[cols - 1] = ' ';
+    if(sim_check(&core, expected, "escape sequences"))
+    {
+        return 1;
+    }
+
+    //a short gap of unchanged cells is bridged by writing them again, not by a set address
+    const u8 last_row = rows - 1;
+    memset(frame, HHG_CELL_KEEP, cells);
+    frame[last_row * cols + 0] = '1';
+    frame[last_row * cols + 2] = '2';
+    hhg_lcd_core_set_addr(&core, geometry.row_offsets[last_row]);
+    unsigned int set_addr = sim.set_addr;
+    hhg_lcd_core_flush(&core, frame);
+    for(u8 i = 0; i < cells; i++)
+    {
+        if(frame[i] != HHG_CELL_KEEP)
+        {
+            expected[i] = frame[i];
+        }
+    }
+    if(sim_check(&core, expected, "bridged run"))
+    {
+        return 1;
+    }
+    if(sim.set_addr != set_addr)
+    {
+        fprintf(stderr, "%ux%u bridged run: %u set address sent\n", cols, rows, sim.set_addr - set_addr);
+        return 1;
+    }
+
+    //random partial frames, as the fields and the animations send them
+    srand(rows * 100 + cols);
+    for(int i = 0; i < SIM_FRAMES; i++)
+    {
+        for(u8 cell = 0; cell < cells; cell++)
+        {
+            int r = rand() % 4;
+            frame[cell] = r == 0 ? 'a' + rand() % 26 : r == 1 ? ' ' : HHG_CELL_KEEP;
+            if(frame[cell] != HHG_CELL_KEEP)
+            {
+                expected[cell] = frame[cell];
+            }
+        }
+        hhg_lcd_core_flush(&core, frame);
+        if(sim_check(&core, expected, "random frame"))
+        {
+            return 1;
+        }
+    }
+
+    printf("%ux%u ok\n", cols, rows);
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if(test_geometry(2, 16)
+        || test_geometry(4, 20)
+        || test_geometry(4, 16)
+        || test_geometry(1, 8)
+        || test_geometry(2, 40))
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "hhg_lcd_gpiod.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+//cd gpiod && make
+//./test_gpiod /dev/gpiochip0
+//without a panel run it on a simulated chip: sudo ../test/gpio-sim.sh up
+//exits 1 on a line error or when the screen does not read back as expected
+
+//LINE OFFSETS ON THE CHIP
+#define LCD_RS  0               //Register select pin
+#define LCD_E   1               //Enable Pin
+#define LCD_D4  2               //Data pin 4
+#define LCD_D5  3               //Data pin 5
+#define LCD_D6  4               //Data pin 6
+#define LCD_D7  5               //Data pin 7
+
+int main(int argc, char* argv[])
+{
+    struct hhg_lcd_gpiod_pins pins = {
+        .chip = argc > 1 ? argv[1] : "/dev/gpiochip0",
+        .rs = LCD_RS,
+        .en = LCD_E,
+        .db = { HHG_GPIOD_LINE_NONE, HHG_GPIOD_LINE_NONE, HHG_GPIOD_LINE_NONE, HHG_GPIOD_LINE_NONE, LCD_D4, LCD_D5, LCD_D6, LCD_D7 },
+    };
+    char screen[HHG_FRAME_MAX_LEN + 1] = { 0 };
+    char counter[16];
+
+    struct hhg_lcd_gpiod* lcd = hhg_lcd_gpiod_open(&pins, NULL, false);
+    if(!lcd)
+    {
+        perror("hhg_lcd_gpiod_open");
+        return 1;
+    }
+
+    const char hello[] = "Hello, Agnesina!";
+    if(hhg_lcd_gpiod_write(lcd, hello, strlen(hello)) != 0)
+    {
+        perror("hhg_lcd_gpiod_write");
+        hhg_lcd_gpiod_close(lcd);
+        return 1;
+    }
+
+    //only the changed digits reach the lines
+    for(int i = 0; i <= 100; i++)
+    {
+        int len = snprintf(counter, sizeof(counter), "\033[2;12H%4d", i);
+        if(hhg_lcd_gpiod_write(lcd, counter, len) != 0)
+        {
+            perror("hhg_lcd_gpiod_write");
+            hhg_lcd_gpiod_close(lcd);
+            return 1;
+        }
+    }
+
+    const char expected[] =
+        "Hello, Agnesina!\n"
+        "            100 \n";
+    size_t len = hhg_lcd_gpiod_read(lcd, screen);
+    printf("%s", screen);
+
+    hhg_lcd_gpiod_close(lcd);
+
+    if(len != strlen(expected) || memcmp(screen, expected, len) != 0)
+    {
+        fprintf(stderr, "screen mismatch, expected:\n%s", expected);
+        return 1;
+    }
+
+    return 0;
+}